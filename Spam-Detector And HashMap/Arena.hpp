@@ -0,0 +1,210 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <string_view>
+#include <utility>
+
+
+#ifndef CPP_EX3_ARENA_HPP
+#define CPP_EX3_ARENA_HPP
+
+static const size_t DEFAULT_CHUNK_SIZE = 64 * 1024;
+
+static const size_t CHUNK_GROWTH_FACTOR = 2;
+
+static const size_t MAX_CHUNK_SIZE = 16 * 1024 * 1024;
+
+/**
+ * A monotonic arena: memory is handed out by bumping a pointer through large chunks and is never given back
+ * one allocation at a time, all of it is released at once by release() or by the destructor.
+ * Meant for maps that are built once and only read afterwards (no erase), where it replaces one malloc per
+ * pair, per key and per bucket with one per chunk.
+ */
+class MonotonicArena
+{
+public:
+
+    /**
+     * Constructor
+     * @param chunkSize - size in bytes of the first chunk, every following chunk is CHUNK_GROWTH_FACTOR larger
+     * up to MAX_CHUNK_SIZE (a larger block gets a chunk of its own size)
+     */
+    explicit MonotonicArena(size_t chunkSize = DEFAULT_CHUNK_SIZE) : _chunks(nullptr), _current(nullptr),
+                                                                     _left(0), _nextChunkSize(chunkSize),
+                                                                     _used(0), _reserved(0)
+    {}
+
+    MonotonicArena(const MonotonicArena & other) = delete;
+
+    MonotonicArena & operator=(const MonotonicArena & other) = delete;
+
+    /**
+     * Destructor
+     */
+    ~MonotonicArena()
+    {
+        release();
+    }
+
+    /**
+     * @param bytes - size of the block
+     * @param alignment - alignment of the block, a power of two
+     * @return an uninitialized block, valid until the arena is released
+     */
+    void *allocate(size_t bytes, size_t alignment = alignof(std::max_align_t))
+    {
+        void *block = _current;
+        if (_current == nullptr or std::align(alignment, bytes, block, _left) == nullptr)
+        {
+            _addChunk(bytes + alignment);
+            block = _current;
+            std::align(alignment, bytes, block, _left);
+        }
+        _current = static_cast<char *>(block) + bytes;
+        _left -= bytes;
+        _used += bytes;
+        return block;
+    }
+
+    /**
+     * Copies the given bytes into the arena
+     * @param text - the bytes to copy
+     * @return a view of the copy, valid until the arena is released
+     */
+    std::string_view store(std::string_view text)
+    {
+        char *copy = static_cast<char *>(allocate(text.size(), alignof(char)));
+        std::memcpy(copy, text.data(), text.size());
+        return std::string_view(copy, text.size());
+    }
+
+    /**
+     * Frees all the chunks at once; everything allocated from the arena is invalid afterwards
+     */
+    void release()
+    {
+        while (_chunks != nullptr)
+        {
+            Chunk *next = _chunks->next;
+            ::operator delete(_chunks);
+            _chunks = next;
+        }
+        _current = nullptr;
+        _left = 0;
+        _used = 0;
+        _reserved = 0;
+    }
+
+    /**
+     * @return number of bytes handed out since the last release
+     */
+    size_t bytesUsed() const
+    {
+        return _used;
+    }
+
+    /**
+     * @return number of bytes taken from the system (the chunks) since the last release
+     */
+    size_t bytesReserved() const
+    {
+        return _reserved;
+    }
+
+private:
+
+    /**
+     * Header of a chunk, the chunk's memory follows it
+     */
+    struct Chunk
+    {
+        Chunk *next;
+    };
+
+    Chunk *_chunks;
+
+    char *_current;
+
+    size_t _left;
+
+    size_t _nextChunkSize;
+
+    size_t _used;
+
+    size_t _reserved;
+
+    /**
+     * Takes a new chunk from the system, large enough for at least the given number of bytes
+     */
+    void _addChunk(size_t bytes)
+    {
+        size_t size = std::max(_nextChunkSize, bytes) + sizeof(Chunk);
+        Chunk *chunk = static_cast<Chunk *>(::operator new(size));
+        chunk->next = _chunks;
+        _chunks = chunk;
+        _current = reinterpret_cast<char *>(chunk + 1);
+        _left = size - sizeof(Chunk);
+        _reserved += size;
+        _nextChunkSize = std::min(_nextChunkSize * CHUNK_GROWTH_FACTOR, std::max(MAX_CHUNK_SIZE, _nextChunkSize));
+    }
+};
+
+template<class T>
+/**
+ * Allocator that takes its memory from a MonotonicArena; deallocate does nothing, the memory goes back
+ * when the arena is released. Copies (and rebinds) share the arena, which must outlive all of them.
+ * @tparam T - the allocated type
+ */
+class ArenaAllocator
+{
+public:
+
+    using value_type = T;
+
+    /**
+     * Constructor
+     * @param arena - the arena to allocate from
+     */
+    ArenaAllocator(MonotonicArena & arena) noexcept : _arena(&arena)
+    {}
+
+    template<class U>
+    ArenaAllocator(const ArenaAllocator<U> & other) noexcept : _arena(other.arena())
+    {}
+
+    T *allocate(size_t count)
+    {
+        return static_cast<T *>(_arena->allocate(count * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T *, size_t) noexcept
+    {}
+
+    /**
+     * @return the arena of the allocator
+     */
+    MonotonicArena *arena() const noexcept
+    {
+        return _arena;
+    }
+
+    template<class U>
+    bool operator==(const ArenaAllocator<U> & other) const noexcept
+    {
+        return _arena == other.arena();
+    }
+
+    template<class U>
+    bool operator!=(const ArenaAllocator<U> & other) const noexcept
+    {
+        return !(*this == other);
+    }
+
+private:
+
+    MonotonicArena *_arena;
+};
+
+#endif
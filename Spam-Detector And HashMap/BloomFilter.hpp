@@ -0,0 +1,169 @@
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include "KeyHash.hpp"
+
+
+#ifndef CPP_EX3_BLOOMFILTER_HPP
+#define CPP_EX3_BLOOMFILTER_HPP
+
+static const size_t FILTER_BLOCK_WORDS = 8;
+
+static const size_t FILTER_BLOCK_BITS = FILTER_BLOCK_WORDS * 32;
+
+static const unsigned int FILTER_BIT_SHIFT = 27;
+
+static const unsigned int FILTER_BLOCK_SHIFT = 32;
+
+/**
+ * Every key sets one bit in each of the FILTER_BLOCK_WORDS words of its block, so for a false positive rate p
+ * about -k / ln(1 - p^(1/k)) bits per key are needed (k = FILTER_BLOCK_WORDS); they are scaled by this as keys
+ * do not spread evenly over the blocks
+ */
+static const double FILTER_BLOCKED_OVERHEAD = 1.1;
+
+static const double FILTER_MIN_RATE = 1e-6;
+
+/**
+ * Odd multipliers picking the bit of every word of a block from the lower half of a hash code (the salts of
+ * the split block Bloom filter of Parquet)
+ */
+static const uint32_t FILTER_SALTS[FILTER_BLOCK_WORDS] = {0x47b6137bu, 0x44974d91u, 0x8824ad5bu, 0xa2b7289du,
+                                                         0x705495c7u, 0x2df1424bu, 0x9efc4947u, 0x5c6bfb31u};
+
+/**
+ * A blocked (split block) Bloom filter of hash codes: a set that may answer "maybe" for a hash code it was
+ * never given, at a chosen false positive rate, but never "no" for one it was.
+ * The bits are split into blocks of FILTER_BLOCK_WORDS words of 32 bits each (256 bits). The upper half
+ * of a hash code picks its block and the lower half one bit in every word of it, so adding or testing a
+ * code touches a single cache line and takes no branch per bit.
+ * Codes cannot be removed; the owner rebuilds the filter from its keys when the stale bits matter.
+ * The hash codes must be well mixed (see mixHash), as those HashMap stores are.
+ */
+class BlockedBloomFilter
+{
+public:
+
+    /**
+     * Constructs an empty filter with no blocks, which must be reset before use
+     */
+    BlockedBloomFilter() = default;
+
+    /**
+     * Empties the filter and sizes it for the given number of hash codes
+     * @param expected - number of hash codes the filter is expected to hold
+     * @param falsePositiveRate - chance that a hash code never added is taken to be in the filter (once the
+     * expected number of codes are in), between FILTER_MIN_RATE and 1
+     */
+    void reset(size_t expected, double falsePositiveRate)
+    {
+        double rate = std::min(std::max(falsePositiveRate, FILTER_MIN_RATE), 1.0);
+        double words = static_cast<double>(FILTER_BLOCK_WORDS);
+        double bitsPerKey = -words / std::log(1 - std::pow(rate, 1 / words)) * FILTER_BLOCKED_OVERHEAD;
+        size_t bits = static_cast<size_t>(std::ceil(bitsPerKey * static_cast<double>(std::max<size_t>(expected, 1))));
+        _blocks.assign(std::max<size_t>(1, (bits + FILTER_BLOCK_BITS - 1) / FILTER_BLOCK_BITS), Block());
+    }
+
+    /**
+     * Adds a hash code to the filter
+     */
+    void add(size_t hash)
+    {
+        Block & block = _blocks[_blockOf(hash)];
+        uint32_t lower = static_cast<uint32_t>(hash);
+        for (size_t i = 0; i < FILTER_BLOCK_WORDS; i++)
+        {
+            block.words[i] |= _bitOf(lower, i);
+        }
+    }
+
+    /**
+     * @return false if the hash code was certainly never added, true if it may have been
+     */
+    bool mayContain(size_t hash) const
+    {
+        const Block & block = _blocks[_blockOf(hash)];
+        uint32_t lower = static_cast<uint32_t>(hash);
+        uint32_t missing = 0;
+        for (size_t i = 0; i < FILTER_BLOCK_WORDS; i++)
+        {
+            missing |= _bitOf(lower, i) & ~block.words[i];
+        }
+        return missing == 0;
+    }
+
+    /**
+     * Starts loading the block of the given hash code into the cache, for a mayContain that follows
+     */
+    void prefetch(size_t hash) const
+    {
+        prefetchAddress(&_blocks[_blockOf(hash)]);
+    }
+
+    /**
+     * Removes all the hash codes, keeping the size
+     */
+    void clear()
+    {
+        _blocks.assign(_blocks.size(), Block());
+    }
+
+    /**
+     * @return true if the filter has not been sized yet (see reset)
+     */
+    bool empty() const
+    {
+        return _blocks.empty();
+    }
+
+    /**
+     * @return bytes of the blocks
+     */
+    size_t allocatedBytes() const
+    {
+        return _blocks.size() * sizeof(Block);
+    }
+
+    /**
+     * This exchanges the contents of two filters
+     */
+    void swap(BlockedBloomFilter & other) noexcept
+    {
+        _blocks.swap(other._blocks);
+    }
+
+private:
+
+    /**
+     * One block of the filter, aligned to its size so it never straddles two cache lines
+     */
+    struct alignas(FILTER_BLOCK_WORDS * sizeof(uint32_t)) Block
+    {
+        uint32_t words[FILTER_BLOCK_WORDS] = {};
+    };
+
+    std::vector<Block> _blocks;
+
+    /**
+     * @return the block of a hash code: the upper half of the code mapped onto the blocks by a multiply and a
+     * shift, so the number of blocks need not be a power of two
+     */
+    size_t _blockOf(size_t hash) const
+    {
+        uint64_t upper = static_cast<uint64_t>(hash) >> FILTER_BLOCK_SHIFT;
+        return static_cast<size_t>((upper * static_cast<uint64_t>(_blocks.size())) >> FILTER_BLOCK_SHIFT);
+    }
+
+    /**
+     * @return the bit the lower half of a hash code sets in the given word of its block
+     */
+    static uint32_t _bitOf(uint32_t lower, size_t word)
+    {
+        return uint32_t(1) << ((lower * FILTER_SALTS[word]) >> FILTER_BIT_SHIFT);
+    }
+};
+
+#endif
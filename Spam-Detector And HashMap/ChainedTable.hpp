@@ -0,0 +1,642 @@
+#include <utility>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "KeyHash.hpp"
+#include "HashMapStats.hpp"
+
+
+#ifndef CPP_EX3_CHAINEDTABLE_HPP
+#define CPP_EX3_CHAINEDTABLE_HPP
+
+static const uint32_t INLINE_ENTRIES = 1;
+
+static const uint32_t BUCKET_GROWTH_FACTOR = 2;
+
+template<class KeyT, class ValueT, class Hash = KeyHash<KeyT>, class KeyEqual = std::equal_to<>,
+        class Allocator = std::allocator<std::pair<KeyT, ValueT>>, bool CacheHash = CacheHashCode<KeyT>::value>
+/**
+ * Separate chaining storage for HashMap: a dynamic array of buckets, each bucket holds the (key,value) pairs
+ * whose keys share the same clamped hash code. A bucket keeps its first pair inline, in the array itself,
+ * and moves its pairs to the heap only when a second one arrives: below the maximal load factor (0.75) most
+ * buckets hold no pair or one, so most pairs cost no allocation and iterating reads the array in order.
+ * With CacheHash every pair is stored along with the hash code of its key, which is compared before the key
+ * on lookups and reused by re-hashing, so re-hashing never hashes a key again.
+ * The table never resizes itself, the owning map decides when and to which capacity to re-hash.
+ * @tparam KeyT - represents a key for the map
+ * @tparam ValueT - represents a value for the map
+ * @tparam Hash - hash function of the keys
+ * @tparam KeyEqual - equality of the keys
+ * @tparam Allocator - allocator of the map, rebound to the table's own node types
+ * @tparam CacheHash - whether every pair keeps the hash code of its key (see CacheHashCode)
+ */
+class ChainedTable
+{
+public:
+
+    using tuple = std::pair<KeyT, ValueT>;
+
+    /**
+     * A pair along with the hash code of its key (if kept)
+     */
+    struct Entry : StoredHash<CacheHash>
+    {
+        tuple pair;
+
+        Entry(tuple && value, size_t code) : pair(std::move(value))
+        {
+            this->storeHash(code);
+        }
+    };
+
+    using entryAllocator = typename std::allocator_traits<Allocator>::template rebind_alloc<Entry>;
+
+    /**
+     * The pairs of one bucket: up to INLINE_ENTRIES of them inline, more in an array on the heap (growing by
+     * BUCKET_GROWTH_FACTOR). Allocating and freeing takes the allocator of the table, which is not kept by
+     * every bucket; the table must clear a bucket before destroying it.
+     */
+    class Bucket
+    {
+    public:
+
+        Bucket() : _size(0), _capacity(INLINE_ENTRIES)
+        {}
+
+        Bucket(const Bucket & other) = delete;
+
+        Bucket & operator=(const Bucket & other) = delete;
+
+        size_t size() const
+        {
+            return _size;
+        }
+
+        Entry & operator[](size_t index) const
+        {
+            return _data()[index];
+        }
+
+        Entry *begin() const
+        {
+            return _data();
+        }
+
+        Entry *end() const
+        {
+            return _data() + _size;
+        }
+
+        /**
+         * Adds an entry built from the given arguments at the end of the bucket
+         * @return the new entry
+         */
+        template<class... Args>
+        Entry & emplace_back(entryAllocator & allocator, Args &&... args)
+        {
+            if (_size == _capacity)
+            {
+                _moveTo(allocator, _capacity * BUCKET_GROWTH_FACTOR);
+            }
+            Entry *entry = new(_data() + _size) Entry(std::forward<Args>(args)...);
+            _size++;
+            return *entry;
+        }
+
+        /**
+         * Removes the entry in the given index, the entries after it move one place back. Back to
+         * INLINE_ENTRIES entries, the heap array is freed.
+         */
+        void erase(entryAllocator & allocator, size_t index)
+        {
+            Entry *entries = _data();
+            for (size_t i = index; i + 1 < _size; i++)
+            {
+                entries[i] = std::move(entries[i + 1]);
+            }
+            entries[--_size].~Entry();
+            if (_onHeap() and _size <= INLINE_ENTRIES)
+            {
+                _moveTo(allocator, INLINE_ENTRIES);
+            }
+        }
+
+        /**
+         * @return bytes of the heap array, 0 while the entries are inline
+         */
+        size_t heapBytes() const
+        {
+            return _onHeap() ? _capacity * sizeof(Entry) : 0;
+        }
+
+        /**
+         * Removes all the entries and frees the heap array
+         */
+        void clear(entryAllocator & allocator)
+        {
+            Entry *entries = _data();
+            for (size_t i = 0; i < _size; i++)
+            {
+                entries[i].~Entry();
+            }
+            if (_onHeap())
+            {
+                std::allocator_traits<entryAllocator>::deallocate(allocator, _heap, _capacity);
+                _capacity = INLINE_ENTRIES;
+            }
+            _size = 0;
+        }
+
+    private:
+
+        uint32_t _size;
+
+        uint32_t _capacity;
+
+        union
+        {
+            alignas(Entry) unsigned char _inline[INLINE_ENTRIES * sizeof(Entry)];
+
+            Entry *_heap;
+        };
+
+        bool _onHeap() const
+        {
+            return _capacity > INLINE_ENTRIES;
+        }
+
+        Entry *_data() const
+        {
+            return _onHeap() ? _heap : reinterpret_cast<Entry *>(const_cast<unsigned char *>(_inline));
+        }
+
+        /**
+         * Moves the entries to storage of the given capacity: inline for INLINE_ENTRIES, a new heap array
+         * otherwise, and frees the previous heap array
+         */
+        void _moveTo(entryAllocator & allocator, uint32_t capacity)
+        {
+            Entry *source = _data();
+            bool sourceOnHeap = _onHeap();
+            uint32_t sourceCapacity = _capacity;
+            Entry *target = capacity > INLINE_ENTRIES ?
+                            std::allocator_traits<entryAllocator>::allocate(allocator, capacity) :
+                            reinterpret_cast<Entry *>(_inline);
+            for (size_t i = 0; i < _size; i++)
+            {
+                new(target + i) Entry(std::move(source[i]));
+                source[i].~Entry();
+            }
+            if (sourceOnHeap)
+            {
+                std::allocator_traits<entryAllocator>::deallocate(allocator, source, sourceCapacity);
+            }
+            _capacity = capacity;
+            if (_onHeap())
+            {
+                _heap = target;
+            }
+        }
+    };
+
+    using bucket = Bucket;
+
+    using bucketAllocator = typename std::allocator_traits<Allocator>::template rebind_alloc<bucket>;
+
+    /**
+     * Location of a pair within the table: its bucket and its index inside the bucket
+     */
+    struct Position
+    {
+        size_t bucket;
+
+        size_t item;
+
+        bool operator==(const Position & other) const
+        {
+            return bucket == other.bucket and item == other.item;
+        }
+    };
+
+    /**
+     * Constructs a table with the given number of buckets
+     * @param capacity - number of buckets, must be a power of two (see validCapacity)
+     * @param hash - hash function of the keys
+     * @param equal - equality of the keys
+     * @param allocator - allocator of the buckets and of the pairs
+     * @param deferSlots - DEFER_SLOTS to allocate the buckets without building them (see initializeSlots)
+     */
+    explicit ChainedTable(size_t capacity = 0, const Hash & hash = Hash(), const KeyEqual & equal = KeyEqual(),
+                          const Allocator & allocator = Allocator(), bool deferSlots = false) :
+            _capacity(capacity), _buckets(nullptr), _hash(hash), _equal(equal), _slotAllocator(allocator)
+    {
+        if (_capacity != 0)
+        {
+            _buckets = _slotAllocator.allocate(_capacity);
+            if (!deferSlots)
+            {
+                initializeSlots(0, _capacity);
+            }
+        }
+    }
+
+    ChainedTable(const ChainedTable & other) = delete;
+
+    ChainedTable & operator=(const ChainedTable & other) = delete;
+
+    /**
+     * Destructor
+     */
+    ~ChainedTable()
+    {
+        if (_buckets != nullptr)
+        {
+            entryAllocator entries(_slotAllocator);
+            for (size_t i = 0; i < _capacity; i++)
+            {
+                _buckets[i].clear(entries);
+                _buckets[i].~bucket();
+            }
+            _slotAllocator.deallocate(_buckets, _capacity);
+        }
+    }
+
+    /**
+     * Builds empty buckets in the given range of a table constructed with DEFER_SLOTS; every bucket must be
+     * built once before the table is used
+     * @param first - first bucket to build
+     * @param last - one past the last bucket to build
+     */
+    void initializeSlots(size_t first, size_t last)
+    {
+        for (size_t i = first; i < last; i++)
+        {
+            new(&_buckets[i]) bucket();
+        }
+    }
+
+    /**
+     * Frees the buckets without visiting them, leaving a table with no buckets. Only for a table holding no
+     * pair: one emptied bucket by bucket by takeBucket, or one whose buckets were never built.
+     */
+    void releaseEmpty()
+    {
+        if (_buckets != nullptr)
+        {
+            // an empty bucket owns no heap array, so there is nothing to destroy
+            _slotAllocator.deallocate(_buckets, _capacity);
+            _buckets = nullptr;
+        }
+        _capacity = 0;
+    }
+
+    /**
+     * @param requested - the capacity the map asked for
+     * @return the nearest capacity this table can be built with (a power of two, at least 1)
+     */
+    static size_t validCapacity(size_t requested)
+    {
+        size_t capacity = 1;
+        while (capacity < requested)
+        {
+            capacity <<= 1;
+        }
+        return capacity;
+    }
+
+    /**
+     * @return the number of buckets
+     */
+    size_t capacity() const
+    {
+        return _capacity;
+    }
+
+    /**
+     * @return the hash function of the table
+     */
+    const Hash & hashFunction() const
+    {
+        return _hash;
+    }
+
+    /**
+     * @return the key equality of the table
+     */
+    const KeyEqual & keyEqual() const
+    {
+        return _equal;
+    }
+
+    /**
+     * @return the allocator of the table
+     */
+    Allocator allocator() const
+    {
+        return Allocator(_slotAllocator);
+    }
+
+    /**
+     * @return number of slots left behind by erase, always 0 as erase never leaves tombstones
+     */
+    size_t tombstones() const
+    {
+        return 0;
+    }
+
+    /**
+     * @param key - key value, or a value of any type the (transparent) hash function accepts
+     * @return the (mixed, see mixHash) hash code of the key, computed once per operation and passed to the
+     * other methods
+     */
+    template<class K>
+    size_t hashOf(const K & key) const
+    {
+        return mixHash(_hash(key));
+    }
+
+    /**
+     * @param hash - hash code of a key
+     * @return the index of the bucket the key belongs to
+     */
+    size_t bucketIndex(size_t hash) const
+    {
+        return _clamp(hash);
+    }
+
+    /**
+     * Starts loading the bucket of the given hash code into the cache, for a find that follows
+     * (the pairs of the bucket are a second load, made by find)
+     * @param hash - hash code of a key
+     */
+    void prefetch(size_t hash) const
+    {
+        prefetchAddress(&_buckets[bucketIndex(hash)]);
+    }
+
+    /**
+     * @param key - key value, or a value of any type the (transparent) hash function accepts
+     * @param hash - hash code of the key
+     * @return position of the pair holding the key, end() if the key is not in the table
+     */
+    template<class K>
+    Position find(const K & key, size_t hash) const
+    {
+        size_t index = bucketIndex(hash);
+        const bucket & source = _buckets[index];
+        for (size_t i = 0; i < source.size(); i++)
+        {
+            if (source[i].hashMatches(hash) and _equal(source[i].pair.first, key))
+            {
+                return {index, i};
+            }
+        }
+        return end();
+    }
+
+    /**
+     * Adds a pair whose key is known not to be in the table
+     * @param pair - (key,value) to add
+     * @param hash - hash code of the key
+     * @return position of the stored pair
+     */
+    Position insertNew(tuple && pair, size_t hash)
+    {
+        size_t index = bucketIndex(hash);
+        entryAllocator entries(_slotAllocator);
+        _buckets[index].emplace_back(entries, std::move(pair), hash);
+        return {index, _buckets[index].size() - 1};
+    }
+
+    /**
+     * Moves every pair of the given table into this one (re-hashing), using the stored hash codes (if kept)
+     * instead of hashing the keys again; the pairs are moved and never compared, as they are known to be distinct.
+     * @param source - table to empty
+     */
+    void takeAll(ChainedTable & source)
+    {
+        for (size_t i = 0; i < source._capacity; i++)
+        {
+            takeBucket(source, i);
+        }
+    }
+
+    /**
+     * Moves the pairs of one bucket of the given table into this one (one step of an incremental re-hash)
+     * @param source - table to move the pairs from
+     * @param index - the bucket in the source table
+     * @return number of pairs moved
+     */
+    size_t takeBucket(ChainedTable & source, size_t index)
+    {
+        bucket & entries = source._buckets[index];
+        size_t moved = entries.size();
+        entryAllocator allocator(_slotAllocator), sourceAllocator(source._slotAllocator);
+        for (Entry & entry : entries)
+        {
+            _buckets[bucketIndex(entry.storedHash(_hash, entry.pair.first))].emplace_back(allocator, std::move(entry));
+        }
+        entries.clear(sourceAllocator);
+        return moved;
+    }
+
+    /**
+     * Moves one pair of the given table into this one, erasing it from the source
+     * @param source - table to move the pair from
+     * @param position - position of the pair in the source table
+     * @return position of the pair in this table
+     */
+    Position takeFrom(ChainedTable & source, const Position & position)
+    {
+        Entry & entry = source._buckets[position.bucket][position.item];
+        size_t index = bucketIndex(entry.storedHash(_hash, entry.pair.first));
+        entryAllocator entries(_slotAllocator);
+        _buckets[index].emplace_back(entries, std::move(entry));
+        source.erase(position);
+        return {index, _buckets[index].size() - 1};
+    }
+
+    /**
+     * Copies every pair of the given table into this one, which must be empty and of the same capacity, bucket by bucket:
+     * the layout is cloned as it is, so no key is hashed, compared or probed for
+     * @param source - table to copy
+     */
+    void cloneFrom(const ChainedTable & source)
+    {
+        entryAllocator entries(_slotAllocator);
+        for (size_t i = 0; i < _capacity; i++)
+        {
+            for (const Entry & entry : source._buckets[i])
+            {
+                _buckets[i].emplace_back(entries, entry);
+            }
+        }
+    }
+
+    /**
+     * Removes the pair in the given position (which must not be end())
+     */
+    void erase(const Position & position)
+    {
+        entryAllocator entries(_slotAllocator);
+        _buckets[position.bucket].erase(entries, position.item);
+    }
+
+    /**
+     * Removes all the pairs, keeping the capacity
+     */
+    void clear()
+    {
+        entryAllocator entries(_slotAllocator);
+        for (size_t i = 0; i < _capacity; i++)
+        {
+            _buckets[i].clear(entries);
+        }
+    }
+
+    /**
+     * @return bytes allocated by the table: the array of buckets and the heap arrays of the buckets
+     */
+    size_t allocatedBytes() const
+    {
+        size_t bytes = _capacity * sizeof(bucket);
+        for (size_t i = 0; i < _capacity; i++)
+        {
+            bytes += _buckets[i].heapBytes();
+        }
+        return bytes;
+    }
+
+    /**
+     * Counts every pair in a probe length histogram (see HashMapStats): the (i+1)th pair of a bucket is found
+     * at the (i+1)th probe
+     * @param histogram - the histogram to add to
+     */
+    void probeLengths(std::vector<size_t> & histogram) const
+    {
+        for (size_t i = 0; i < _capacity; i++)
+        {
+            for (size_t item = 1; item <= _buckets[i].size(); item++)
+            {
+                countProbeLength(histogram, item);
+            }
+        }
+    }
+
+    /**
+     * @param hash - hash code of a key
+     * @return number of pairs that share the bucket of the key
+     */
+    size_t bucketSize(size_t hash) const
+    {
+        return _buckets[bucketIndex(hash)].size();
+    }
+
+    /**
+     * @return position of the first pair in the table or end() if the table is empty
+     */
+    Position begin() const
+    {
+        Position position = {0, 0};
+        _skipEmpty(position);
+        return position;
+    }
+
+    /**
+     * @return the position past the last pair, the same for every table and every capacity
+     */
+    Position end() const
+    {
+        return {END_BUCKET, 0};
+    }
+
+    /**
+     * Moves the given position to the next pair in the table (or to end())
+     */
+    void advance(Position & position) const
+    {
+        position.item++;
+        _skipEmpty(position);
+    }
+
+    /**
+     * @return the pair in the given position (which must not be end())
+     */
+    tuple & at(const Position & position) const
+    {
+        return _buckets[position.bucket][position.item].pair;
+    }
+
+    /**
+     * @return the hash code of the key of the pair in the given position (which must not be end()), without
+     * hashing the key when the table keeps hash codes
+     */
+    size_t hashAt(const Position & position) const
+    {
+        return _buckets[position.bucket][position.item].storedHash(_hash, at(position).first);
+    }
+
+    /**
+     * This exchanges the contents of two tables
+     */
+    void swap(ChainedTable & other) noexcept
+    {
+        std::swap(_capacity, other._capacity);
+        std::swap(_buckets, other._buckets);
+        std::swap(_hash, other._hash);
+        std::swap(_equal, other._equal);
+        std::swap(_slotAllocator, other._slotAllocator);
+    }
+
+private:
+
+    size_t _capacity;
+
+    bucket *_buckets;
+
+    Hash _hash;
+
+    KeyEqual _equal;
+
+    bucketAllocator _slotAllocator;
+
+    /**
+     * Clamps hashing indices to fit within the current table capacity
+     *
+     * @param index - the index before clamping
+     * @return An index properly clamped
+     */
+    size_t _clamp(size_t index) const
+    {
+        return index & (_capacity - 1);
+    }
+
+    /**
+     * Moves the given position forward until it points to a pair or to end()
+     */
+    void _skipEmpty(Position & position) const
+    {
+        while (position.bucket < _capacity and position.item >= _buckets[position.bucket].size())
+        {
+            position.bucket++;
+            position.item = 0;
+        }
+        if (position.bucket == _capacity)
+        {
+            position = end();
+        }
+    }
+};
+
+/**
+ * Storage policy of HashMap: separate chaining (the default)
+ */
+struct ChainedStorage
+{
+    template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator>
+    using table = ChainedTable<KeyT, ValueT, Hash, KeyEqual, Allocator, CacheHashCode<KeyT>::value>;
+};
+
+#endif
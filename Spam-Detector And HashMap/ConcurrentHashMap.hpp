@@ -0,0 +1,419 @@
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <utility>
+#include "HashMap.hpp"
+
+
+#ifndef CPP_EX3_CONCURRENTHASHMAP_HPP
+#define CPP_EX3_CONCURRENTHASHMAP_HPP
+
+static const size_t DEFAULT_SHARDS = 64;
+
+static const size_t CACHE_LINE = 64;
+
+static const uint64_t SHARD_MIX = 0x9e3779b97f4a7c15ull;
+
+static const unsigned int SHARD_SHIFT = 32;
+
+template<class KeyT, class ValueT, class Hash = KeyHash<KeyT>, class KeyEqual = std::equal_to<>,
+        class Allocator = std::allocator<std::pair<KeyT, ValueT>>, class Storage = ChainedStorage>
+/**
+ * A hash map that can be shared between threads: the keys are split by their hash code between
+ * independent shards, each a HashMap guarded by its own reader-writer lock, so threads working on
+ * different shards never wait for each other and readers of the same shard never wait for each other.
+ * A lookup hashes its key once, the same hash code picks the shard and probes the shard's table.
+ * Every operation on a single key is atomic. Operations on the whole map (size, clear, forEach) visit the
+ * shards one after the other, so they are not a snapshot of the map when other threads update it.
+ * Values are never handed out by reference, they are copied out (get) or reached through a function that
+ * runs under the lock (visit, update, compute).
+ * @tparam KeyT - represents a key for the map
+ * @tparam ValueT - represents a value for the map
+ * @tparam Hash - hash function of the keys
+ * @tparam KeyEqual - equality of the keys
+ * @tparam Allocator - allocator of the pairs
+ * @tparam Storage - storage policy of the shards (see HashMap)
+ */
+class ConcurrentHashMap
+{
+    using shardMap = HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>;
+
+    /**
+     * One shard: a map and its lock, on a cache line of their own so that locking one shard does not slow
+     * down the cores working on its neighbours
+     */
+    struct alignas(CACHE_LINE) Shard
+    {
+        mutable std::shared_mutex mutex;
+
+        shardMap map;
+
+        Shard(const Hash & hash, const KeyEqual & equal, const Allocator & allocator) : map(hash, equal, allocator)
+        {}
+    };
+
+public:
+
+    typedef Hash hasher;
+
+    typedef KeyEqual key_equal;
+
+    typedef Allocator allocator_type;
+
+    /**
+     * Constructor
+     * @param shards - number of shards, rounded up to a power of two; more shards than threads keep
+     * the threads from meeting on the same lock
+     * @param hash - hash function of the keys
+     * @param equal - equality of the keys
+     * @param allocator - allocator of the pairs
+     */
+    explicit ConcurrentHashMap(size_t shards = DEFAULT_SHARDS, const Hash & hash = Hash(),
+                               const KeyEqual & equal = KeyEqual(), const Allocator & allocator = Allocator());
+
+    ConcurrentHashMap(const ConcurrentHashMap & other) = delete;
+
+    ConcurrentHashMap & operator=(const ConcurrentHashMap & other) = delete;
+
+    /**
+     * Destructor
+     */
+    ~ConcurrentHashMap();
+
+    /**
+     * Adds the pair if the key is not in the map
+     * @param key - key value
+     * @param value - value of the key
+     * @return true if the pair has been added and false if the key was already in the map
+     */
+    bool insert(const KeyT & key, const ValueT & value);
+
+    /**
+     * Maps the key to the given value, whether or not it was in the map
+     * @param key - key value
+     * @param value - the new value of the key
+     * @return true if the pair has been added and false if an existing value has been replaced
+     */
+    template<class M>
+    bool insert_or_assign(const KeyT & key, M && value);
+
+    /**
+     * Applies the function to the value of the key, which is first added (value constructed from the given
+     * arguments) if the key is not in the map; all of it as one atomic operation, e.g. counting:
+     * map.compute(word, [](int & count) { count++; }, 0);
+     * @param key - key value
+     * @param function - called with a ValueT & while the shard of the key is locked
+     * @param args - arguments to construct the value from if the key is added
+     * @return true if the pair has been added
+     */
+    template<class F, class... Args>
+    bool compute(const KeyT & key, F && function, Args && ... args);
+
+    /**
+     * Applies the function to the value of the key if the key is in the map, as one atomic operation
+     * @param key - key value (or any type the hash function accepts)
+     * @param function - called with a ValueT & while the shard of the key is locked
+     * @return true if the key is in the map
+     */
+    template<class K, class F>
+    bool update(const K & key, F && function);
+
+    /**
+     * Calls the function with the value of the key if the key is in the map, other readers of the shard
+     * run at the same time and writers wait
+     * @param key - key value (or any type the hash function accepts)
+     * @param function - called with a const ValueT & while the shard of the key is locked for reading
+     * @return true if the key is in the map
+     */
+    template<class K, class F>
+    bool visit(const K & key, F && function) const;
+
+    /**
+     * Copies the value of the key out of the map
+     * @param key - key value (or any type the hash function accepts)
+     * @param value - set to the value of the key if it is in the map
+     * @return true if the key is in the map
+     */
+    template<class K>
+    bool get(const K & key, ValueT & value) const;
+
+    /**
+     * @return True if the given key contained in the map and false otherwise
+     */
+    template<class K>
+    bool containsKey(const K & key) const;
+
+    /**
+     * This method is given a key and tries to erase the the pair which contains it
+     * @param key - key value (or any type the hash function accepts)
+     * @return true if the pair has been removed and false otherwise
+     */
+    template<class K>
+    bool erase(const K & key);
+
+    /**
+     * Calls the function with every pair of the map, a shard at a time, while that shard is locked for reading
+     * @param function - called with a const std::pair<KeyT, ValueT> &
+     */
+    template<class F>
+    void forEach(F && function) const;
+
+    /**
+     * @return number of pairs in the map
+     */
+    size_t size() const;
+
+    /**
+     * @return true if the map is empty and false otherwise
+     */
+    bool empty() const;
+
+    /**
+     * Removes all the pairs of the map
+     */
+    void clear();
+
+    /**
+     * Makes room for the given number of pairs, spread evenly over the shards
+     * @param count - number of pairs the map should hold without re-hashing
+     */
+    void reserve(size_t count);
+
+    /**
+     * @return number of shards
+     */
+    size_t shards() const;
+
+private:
+
+    std::deque<Shard> _shards;
+
+    size_t _shardCount;
+
+    Hash _hash;
+
+    /**
+     * @param hash - hash code of a key
+     * @return the shard of the key
+     */
+    Shard & _shardOf(size_t hash);
+
+    /**
+     * @param hash - hash code of a key
+     * @return the shard of the key
+     */
+    const Shard & _shardOf(size_t hash) const;
+
+    /**
+     * @param hash - hash code of a key
+     * @return the index of the shard of the key: the high bits of a multiplication, which all the bits of the
+     * hash code take part in, as the tables of the shards index by the low bits of the same hash code
+     */
+    size_t _shardIndex(size_t hash) const;
+};
+
+//=================ConcurrentHashMap implementation==================//
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+ConcurrentHashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::ConcurrentHashMap(size_t shards,
+                                                                                       const Hash & hash,
+                                                                                       const KeyEqual & equal,
+                                                                                       const Allocator & allocator) :
+        _shardCount(1), _hash(hash)
+{
+    while (_shardCount < shards)
+    {
+        _shardCount <<= 1;
+    }
+    // a deque never moves its elements, so it can hold the (immovable) locks
+    for (size_t i = 0; i < _shardCount; i++)
+    {
+        _shards.emplace_back(hash, equal, allocator);
+    }
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+ConcurrentHashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::~ConcurrentHashMap() = default;
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+bool ConcurrentHashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::insert(const KeyT & key,
+                                                                                 const ValueT & value)
+{
+    size_t hash = mixHash(_hash(key));
+    Shard & shard = _shardOf(hash);
+    std::unique_lock<std::shared_mutex> lock(shard.mutex);
+    return shard.map._tryEmplace(typename shardMap::KnownHash{hash}, key, value).second;
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+template<class M>
+bool ConcurrentHashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::insert_or_assign(const KeyT & key,
+                                                                                           M && value)
+{
+    size_t hash = mixHash(_hash(key));
+    Shard & shard = _shardOf(hash);
+    std::unique_lock<std::shared_mutex> lock(shard.mutex);
+    auto result = shard.map._tryEmplace(typename shardMap::KnownHash{hash}, key, std::forward<M>(value));
+    if (!result.second)
+    {
+        shard.map._table.at(result.first).second = std::forward<M>(value);
+    }
+    return result.second;
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+template<class F, class... Args>
+bool ConcurrentHashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::compute(const KeyT & key, F && function,
+                                                                                  Args && ... args)
+{
+    size_t hash = mixHash(_hash(key));
+    Shard & shard = _shardOf(hash);
+    std::unique_lock<std::shared_mutex> lock(shard.mutex);
+    auto result = shard.map._tryEmplace(typename shardMap::KnownHash{hash}, key, std::forward<Args>(args)...);
+    function(shard.map._table.at(result.first).second);
+    return result.second;
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+template<class K, class F>
+bool ConcurrentHashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::update(const K & key, F && function)
+{
+    size_t hash = mixHash(_hash(key));
+    Shard & shard = _shardOf(hash);
+    std::unique_lock<std::shared_mutex> lock(shard.mutex);
+    std::pair<KeyT, ValueT> *pair = shard.map._lookup(key, hash);
+    if (pair == nullptr)
+    {
+        return false;
+    }
+    function(pair->second);
+    return true;
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+template<class K, class F>
+bool ConcurrentHashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::visit(const K & key, F && function) const
+{
+    size_t hash = mixHash(_hash(key));
+    const Shard & shard = _shardOf(hash);
+    std::shared_lock<std::shared_mutex> lock(shard.mutex);
+    const std::pair<KeyT, ValueT> *pair = shard.map._lookup(key, hash);
+    if (pair == nullptr)
+    {
+        return false;
+    }
+    function(pair->second);
+    return true;
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+template<class K>
+bool ConcurrentHashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::get(const K & key, ValueT & value) const
+{
+    return visit(key, [&value](const ValueT & found)
+    {
+        value = found;
+    });
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+template<class K>
+bool ConcurrentHashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::containsKey(const K & key) const
+{
+    return visit(key, [](const ValueT &)
+    {});
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+template<class K>
+bool ConcurrentHashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::erase(const K & key)
+{
+    size_t hash = mixHash(_hash(key));
+    Shard & shard = _shardOf(hash);
+    std::unique_lock<std::shared_mutex> lock(shard.mutex);
+    return shard.map._erase(key, hash);
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+template<class F>
+void ConcurrentHashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::forEach(F && function) const
+{
+    for (size_t i = 0; i < _shardCount; i++)
+    {
+        std::shared_lock<std::shared_mutex> lock(_shards[i].mutex);
+        for (const auto & pair : _shards[i].map)
+        {
+            function(pair);
+        }
+    }
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+size_t ConcurrentHashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::size() const
+{
+    size_t total = 0;
+    for (size_t i = 0; i < _shardCount; i++)
+    {
+        std::shared_lock<std::shared_mutex> lock(_shards[i].mutex);
+        total += _shards[i].map.size();
+    }
+    return total;
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+bool ConcurrentHashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::empty() const
+{
+    return size() == 0;
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+void ConcurrentHashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::clear()
+{
+    for (size_t i = 0; i < _shardCount; i++)
+    {
+        std::unique_lock<std::shared_mutex> lock(_shards[i].mutex);
+        _shards[i].map.clear();
+    }
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+void ConcurrentHashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::reserve(size_t count)
+{
+    size_t perShard = (count + _shardCount - 1) / _shardCount;
+    for (size_t i = 0; i < _shardCount; i++)
+    {
+        std::unique_lock<std::shared_mutex> lock(_shards[i].mutex);
+        _shards[i].map.reserve(perShard);
+    }
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+size_t ConcurrentHashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::shards() const
+{
+    return _shardCount;
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+typename ConcurrentHashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::Shard &
+ConcurrentHashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::_shardOf(size_t hash)
+{
+    return _shards[_shardIndex(hash)];
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+const typename ConcurrentHashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::Shard &
+ConcurrentHashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::_shardOf(size_t hash) const
+{
+    return _shards[_shardIndex(hash)];
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+size_t ConcurrentHashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::_shardIndex(size_t hash) const
+{
+    return static_cast<size_t>((static_cast<uint64_t>(hash) * SHARD_MIX) >> SHARD_SHIFT) & (_shardCount - 1);
+}
+
+#endif
@@ -0,0 +1,137 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <mutex>
+#include <vector>
+#include "ConcurrentHashMap.hpp"
+
+static const size_t KEY_RANGE = 1 << 16;
+
+static const size_t OPERATIONS_PER_THREAD = 200000;
+
+static const size_t MAX_THREADS = 64;
+
+static const uint64_t RANDOM_SEED = 20240601;
+
+static const int PERCENT = 100;
+
+/**
+ * Percent of the operations that are reads (the rest are insert_or_assign and erase, half each)
+ */
+static const int READ_PERCENTS[] = {50, 90, 99};
+
+/**
+ * A HashMap shared the only way it could be before ConcurrentHashMap: behind one global mutex
+ */
+class GlobalLockMap
+{
+public:
+
+    bool containsKey(size_t key) const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _map.containsKey(key);
+    }
+
+    void insert_or_assign(size_t key, size_t value)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _map.insert_or_assign(key, value);
+    }
+
+    void erase(size_t key)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _map.erase(key);
+    }
+
+private:
+
+    mutable std::mutex _mutex;
+
+    HashMap<size_t, size_t> _map;
+};
+
+/**
+ * Runs the given number of threads, each doing OPERATIONS_PER_THREAD random operations on the map
+ * @param map - the map to share
+ * @param threads - number of threads
+ * @param readPercent - percent of the operations that are reads
+ * @return throughput in millions of operations per second
+ */
+template<class Map>
+double run(Map & map, size_t threads, int readPercent)
+{
+    std::vector<std::thread> workers;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t t = 0; t < threads; t++)
+    {
+        workers.emplace_back([&map, t, readPercent]()
+        {
+            std::mt19937_64 generator(RANDOM_SEED + t);
+            std::uniform_int_distribution<size_t> keys(0, KEY_RANGE - 1);
+            std::uniform_int_distribution<int> percents(0, PERCENT - 1);
+            size_t found = 0;
+            for (size_t i = 0; i < OPERATIONS_PER_THREAD; i++)
+            {
+                size_t key = keys(generator);
+                int operation = percents(generator);
+                if (operation < readPercent)
+                {
+                    found += map.containsKey(key);
+                }
+                else if ((operation - readPercent) % 2 == 0)
+                {
+                    map.insert_or_assign(key, i);
+                }
+                else
+                {
+                    map.erase(key);
+                }
+            }
+            volatile size_t sink = found;
+            (void) sink;
+        });
+    }
+    for (std::thread & worker : workers)
+    {
+        worker.join();
+    }
+    auto stop = std::chrono::steady_clock::now();
+    double seconds = std::chrono::duration<double>(stop - start).count();
+    return static_cast<double>(threads * OPERATIONS_PER_THREAD) / seconds / 1e6;
+}
+
+/**
+ * Measures the throughput of ConcurrentHashMap and of a HashMap behind a global mutex, from 1 to MAX_THREADS
+ * threads and for a few read/write mixes, in millions of operations per second (higher is better)
+ */
+int main()
+{
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "hardware threads: " << std::thread::hardware_concurrency() << "\n";
+    for (int readPercent : READ_PERCENTS)
+    {
+        std::cout << readPercent << "% reads (Mops/s)\n";
+        std::cout << std::setw(10) << "threads" << std::setw(14) << "sharded" << std::setw(14) << "global lock"
+                  << "\n";
+        for (size_t threads = 1; threads <= MAX_THREADS; threads *= 2)
+        {
+            ConcurrentHashMap<size_t, size_t> sharded;
+            GlobalLockMap global;
+            for (size_t key = 0; key < KEY_RANGE; key += 2)
+            {
+                sharded.insert_or_assign(key, key);
+                global.insert_or_assign(key, key);
+            }
+            double shardedThroughput = run(sharded, threads, readPercent);
+            double globalThroughput = run(global, threads, readPercent);
+            std::cout << std::setw(10) << threads << std::setw(14) << shardedThroughput << std::setw(14)
+                      << globalThroughput << "\n";
+        }
+        std::cout << "\n";
+    }
+    return 0;
+}
@@ -0,0 +1,279 @@
+#include <iostream>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <map>
+#include <random>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "HashMap.hpp"
+
+static const size_t SIZES[] = {1000, 10000, 100000, 1000000, 10000000, 100000000};
+
+static const size_t DEFAULT_MAX_SIZE = 1000000;
+
+static const size_t MIN_OPERATIONS = 2000000;
+
+static const uint64_t RANDOM_SEED = 20240601;
+
+static const size_t SHORT_KEY = 8;
+
+static const size_t MEDIUM_KEY = 32;
+
+static const size_t LONG_KEY = 128;
+
+static const size_t REHASH_FACTOR = 4;
+
+static const char *const FIRST_LETTER = "a";
+
+static const int LETTERS = 26;
+
+static const char *const CSV_HEADER = "container,key,size,operation,ns_per_op";
+
+static const char *const USAGE = "Usage: ContainerBenchmark [max size (default 1000000, up to 100000000)]\n";
+
+/**
+ * Keys of one type and size: the keys in the map, and as many keys that are not
+ */
+template<class Key>
+struct KeySet
+{
+    std::vector<Key> present;
+
+    std::vector<Key> absent;
+};
+
+/**
+ * Makes a key from a random number: the number itself for integers, for strings the given number of random
+ * lower case letters followed by the digits of the index (so every key is distinct)
+ */
+uint64_t makeKey(uint64_t random, size_t, size_t, uint64_t)
+{
+    return random;
+}
+
+std::string makeKey(uint64_t random, size_t index, size_t length, std::string)
+{
+    std::string key = std::to_string(index);
+    std::mt19937_64 letters(random);
+    while (key.size() < length)
+    {
+        key.insert(key.begin(), static_cast<char>(FIRST_LETTER[0] + letters() % LETTERS));
+    }
+    return key;
+}
+
+/**
+ * @return count keys in the map and count keys that are not, of the given length for strings
+ */
+template<class Key>
+KeySet<Key> makeKeys(size_t count, size_t length)
+{
+    std::mt19937_64 generator(RANDOM_SEED);
+    KeySet<Key> keys;
+    keys.present.reserve(count);
+    keys.absent.reserve(count);
+    for (size_t i = 0; i < count * 2; i++)
+    {
+        // even numbers in the map and odd ones out, so integer keys never collide between the two sets
+        uint64_t random = generator();
+        if (i % 2 == 0)
+        {
+            keys.present.push_back(makeKey(random & ~uint64_t(1), i, length, Key()));
+        }
+        else
+        {
+            keys.absent.push_back(makeKey(random | 1, i, length, Key()));
+        }
+    }
+    return keys;
+}
+
+/**
+ * Runs the given function enough times to do at least MIN_OPERATIONS operations
+ * @param operations - number of operations one run does
+ * @param setup - called before every run, not timed
+ * @param run - the timed operations
+ * @return nanoseconds per operation, the best run
+ */
+template<class Setup, class Run>
+double nanosPerOperation(size_t operations, Setup setup, Run run)
+{
+    size_t runs = std::max<size_t>(1, MIN_OPERATIONS / std::max<size_t>(operations, 1));
+    double best = 0;
+    for (size_t i = 0; i < runs; i++)
+    {
+        setup();
+        auto start = std::chrono::steady_clock::now();
+        run();
+        auto stop = std::chrono::steady_clock::now();
+        double nanos = std::chrono::duration<double, std::nano>(stop - start).count() / operations;
+        if (i == 0 or nanos < best)
+        {
+            best = nanos;
+        }
+    }
+    return best;
+}
+
+template<class Map, class = void>
+/**
+ * true for the containers that can re-hash (not std::map)
+ */
+struct CanRehash : std::false_type
+{
+};
+
+template<class Map>
+struct CanRehash<Map, decltype(std::declval<Map &>().rehash(size_t()), void())> : std::true_type
+{
+};
+
+/**
+ * Prints one CSV line
+ */
+void report(const std::string & container, const std::string & key, size_t size, const std::string & operation,
+            double nanos)
+{
+    std::cout << container << "," << key << "," << size << "," << operation << "," << nanos << "\n";
+}
+
+/**
+ * Measures every operation of one container with one key set: insert (into an empty map), successful and
+ * unsuccessful find, erase (of every key), iteration, copy and re-hash (to REHASH_FACTOR buckets per key)
+ */
+template<class Map>
+void measure(const std::string & container, const std::string & keyName, const KeySet<typename Map::key_type> & keys)
+{
+    size_t size = keys.present.size();
+    volatile size_t sink = 0;
+    Map map;
+
+    report(container, keyName, size, "insert", nanosPerOperation(size, [&]()
+    {
+        map = Map();
+    }, [&]()
+    {
+        for (size_t i = 0; i < size; i++)
+        {
+            map.try_emplace(keys.present[i], i);
+        }
+    }));
+
+    report(container, keyName, size, "find_hit", nanosPerOperation(size, []()
+    {}, [&]()
+    {
+        size_t found = 0;
+        for (const auto & key : keys.present)
+        {
+            found += map.find(key) != map.end();
+        }
+        sink = sink + found;
+    }));
+
+    report(container, keyName, size, "find_miss", nanosPerOperation(size, []()
+    {}, [&]()
+    {
+        size_t found = 0;
+        for (const auto & key : keys.absent)
+        {
+            found += map.find(key) != map.end();
+        }
+        sink = sink + found;
+    }));
+
+    report(container, keyName, size, "iterate", nanosPerOperation(size, []()
+    {}, [&]()
+    {
+        size_t sum = 0;
+        for (const auto & pair : map)
+        {
+            sum += pair.second;
+        }
+        sink = sink + sum;
+    }));
+
+    report(container, keyName, size, "copy", nanosPerOperation(size, []()
+    {}, [&]()
+    {
+        Map copy(map);
+        sink = sink + copy.size();
+    }));
+
+    if constexpr (CanRehash<Map>::value)
+    {
+        Map rehashed;
+        report(container, keyName, size, "rehash", nanosPerOperation(size, [&]()
+        {
+            rehashed = map;
+        }, [&]()
+        {
+            rehashed.rehash(size * REHASH_FACTOR);
+        }));
+    }
+
+    report(container, keyName, size, "erase", nanosPerOperation(size, [&]()
+    {
+        if (map.size() != size)
+        {
+            for (size_t i = 0; i < size; i++)
+            {
+                map.try_emplace(keys.present[i], i);
+            }
+        }
+    }, [&]()
+    {
+        for (const auto & key : keys.present)
+        {
+            map.erase(key);
+        }
+    }));
+}
+
+/**
+ * Measures HashMap in its four storages, std::unordered_map and std::map with the given keys
+ */
+template<class Key>
+void measureAll(const std::string & keyName, size_t size, size_t length)
+{
+    KeySet<Key> keys = makeKeys<Key>(size, length);
+    measure<HashMap<Key, size_t>>("HashMap", keyName, keys);
+    measure<RobinHoodHashMap<Key, size_t>>("RobinHoodHashMap", keyName, keys);
+    measure<SwissHashMap<Key, size_t>>("SwissHashMap", keyName, keys);
+    measure<DenseHashMap<Key, size_t>>("DenseHashMap", keyName, keys);
+    measure<std::unordered_map<Key, size_t>>("std::unordered_map", keyName, keys);
+    measure<std::map<Key, size_t>>("std::map", keyName, keys);
+}
+
+/**
+ * Compares HashMap (in all its storages) with std::unordered_map and std::map: insert, successful and
+ * unsuccessful lookup, erase, iteration, copy and re-hash, with integer keys and short, medium and long
+ * string keys, from 1K keys up to the given maximum (100M needs tens of gigabytes).
+ * Prints CSV (container,key,size,operation,ns_per_op) to the standard output, to be kept and compared between
+ * releases.
+ */
+int main(int argc, char *argv[])
+{
+    size_t maxSize = DEFAULT_MAX_SIZE;
+    if (argc > 2 or (argc == 2 and (maxSize = std::strtoull(argv[1], nullptr, 10)) == 0))
+    {
+        std::cerr << USAGE;
+        return EXIT_FAILURE;
+    }
+    std::cout << CSV_HEADER << "\n";
+    for (size_t size : SIZES)
+    {
+        if (size > maxSize)
+        {
+            break;
+        }
+        measureAll<uint64_t>("int", size, 0);
+        measureAll<std::string>("string" + std::to_string(SHORT_KEY), size, SHORT_KEY);
+        measureAll<std::string>("string" + std::to_string(MEDIUM_KEY), size, MEDIUM_KEY);
+        measureAll<std::string>("string" + std::to_string(LONG_KEY), size, LONG_KEY);
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,649 @@
+#include <algorithm>
+#include <utility>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "KeyHash.hpp"
+#include "HashMapStats.hpp"
+#include <new>
+
+
+#ifndef CPP_EX3_DENSETABLE_HPP
+#define CPP_EX3_DENSETABLE_HPP
+
+static const unsigned int FREE_INDEX_SLOT = 0;
+
+static const size_t ENTRY_GROWTH_FACTOR = 2;
+
+static const unsigned int FINGERPRINT_SHIFT = 32;
+
+template<class KeyT, class ValueT, class Hash = KeyHash<KeyT>, class KeyEqual = std::equal_to<>,
+        class Allocator = std::allocator<std::pair<KeyT, ValueT>>, bool CacheHash = CacheHashCode<KeyT>::value>
+/**
+ * Dense storage for HashMap: the (key,value) pairs are packed one after the other in an entries array, in the
+ * order they were added, and the hash index is a separate array of small slots holding the number of an
+ * entry. Iterating the map is a straight scan of the entries, whatever the capacity, and never touches
+ * the index.
+ * The index is open addressing with Robin Hood probing and backward-shift deletion (as RobinHoodTable),
+ * every slot keeps the upper bits of its key's hash code, so a probe reads the entries only for a likely match.
+ * erase moves the last entry into the hole it leaves, keeping the entries packed: the order is the insertion
+ * order until the first erase (and until an incremental re-hash, which moves the pairs slot by slot).
+ * With CacheHash every entry keeps the hash code of its key, so re-hashing and erase never hash a key again.
+ * The table never resizes its index itself, the owning map decides when and to which capacity to re-hash.
+ * @tparam KeyT - represents a key for the map
+ * @tparam ValueT - represents a value for the map
+ * @tparam Hash - hash function of the keys
+ * @tparam KeyEqual - equality of the keys
+ * @tparam Allocator - allocator of the map, rebound to the table's own node types
+ * @tparam CacheHash - whether every pair keeps the hash code of its key (see CacheHashCode)
+ */
+class DenseTable
+{
+public:
+
+    using tuple = std::pair<KeyT, ValueT>;
+
+    /**
+     * Location of a pair within the table: its entry (item is always 0)
+     */
+    struct Position
+    {
+        size_t bucket;
+
+        size_t item;
+
+        bool operator==(const Position & other) const
+        {
+            return bucket == other.bucket and item == other.item;
+        }
+    };
+
+    /**
+     * Constructs a table with the given number of index slots and no entries
+     * @param capacity - number of index slots, must be a power of two (see validCapacity)
+     * @param hash - hash function of the keys
+     * @param equal - equality of the keys
+     * @param allocator - allocator of the index and of the entries
+     * @param deferSlots - DEFER_SLOTS to allocate the index without marking it free (see initializeSlots), along
+     * with entries for as many pairs as the index has slots, so filling the table never moves them
+     */
+    explicit DenseTable(size_t capacity = 0, const Hash & hash = Hash(), const KeyEqual & equal = KeyEqual(),
+                        const Allocator & allocator = Allocator(), bool deferSlots = false) :
+            _capacity(capacity), _slots(nullptr), _entries(nullptr), _count(0), _entryCapacity(0), _hash(hash),
+            _equal(equal), _slotAllocator(allocator), _entryAllocator(allocator)
+    {
+        if (_capacity != 0)
+        {
+            _slots = _slotAllocator.allocate(_capacity);
+            if (!deferSlots)
+            {
+                initializeSlots(0, _capacity);
+                return;
+            }
+            _entries = _entryAllocator.allocate(_capacity);
+            _entryCapacity = _capacity;
+        }
+    }
+
+    DenseTable(const DenseTable & other) = delete;
+
+    DenseTable & operator=(const DenseTable & other) = delete;
+
+    /**
+     * Destructor
+     */
+    ~DenseTable()
+    {
+        clear();
+        if (_slots != nullptr)
+        {
+            _slotAllocator.deallocate(_slots, _capacity);
+        }
+        if (_entries != nullptr)
+        {
+            _entryAllocator.deallocate(_entries, _entryCapacity);
+        }
+    }
+
+    /**
+     * Marks the index slots in the given range of a table constructed with DEFER_SLOTS free; every slot must be
+     * marked once before the table is used
+     * @param first - first index slot to mark
+     * @param last - one past the last index slot to mark
+     */
+    void initializeSlots(size_t first, size_t last)
+    {
+        for (size_t i = first; i < last; i++)
+        {
+            _slots[i].distance = FREE_INDEX_SLOT;
+        }
+    }
+
+    /**
+     * Frees the index and the entries without visiting them, leaving a table with no slots. Only for a table
+     * holding no pair: one emptied slot by slot by takeBucket, or one whose slots were never marked.
+     */
+    void releaseEmpty()
+    {
+        if (_slots != nullptr)
+        {
+            _slotAllocator.deallocate(_slots, _capacity);
+            _slots = nullptr;
+        }
+        if (_entries != nullptr)
+        {
+            _entryAllocator.deallocate(_entries, _entryCapacity);
+            _entries = nullptr;
+        }
+        _capacity = 0;
+        _entryCapacity = 0;
+    }
+
+    /**
+     * @param requested - the capacity the map asked for
+     * @return the nearest capacity this table can be built with (a power of two, at least 1)
+     */
+    static size_t validCapacity(size_t requested)
+    {
+        size_t capacity = 1;
+        while (capacity < requested)
+        {
+            capacity <<= 1;
+        }
+        return capacity;
+    }
+
+    /**
+     * @return the number of index slots
+     */
+    size_t capacity() const
+    {
+        return _capacity;
+    }
+
+    /**
+     * @return the hash function of the table
+     */
+    const Hash & hashFunction() const
+    {
+        return _hash;
+    }
+
+    /**
+     * @return the key equality of the table
+     */
+    const KeyEqual & keyEqual() const
+    {
+        return _equal;
+    }
+
+    /**
+     * @return the allocator of the table
+     */
+    Allocator allocator() const
+    {
+        return Allocator(_slotAllocator);
+    }
+
+    /**
+     * @return number of slots left behind by erase, always 0 as erase never leaves tombstones
+     */
+    size_t tombstones() const
+    {
+        return 0;
+    }
+
+    /**
+     * @param key - key value, or a value of any type the (transparent) hash function accepts
+     * @return the (mixed, see mixHash) hash code of the key, computed once per operation and passed to the
+     * other methods
+     */
+    template<class K>
+    size_t hashOf(const K & key) const
+    {
+        return mixHash(_hash(key));
+    }
+
+    /**
+     * @param hash - hash code of a key
+     * @return the home slot of the key in the index (the slot probing starts from)
+     */
+    size_t bucketIndex(size_t hash) const
+    {
+        return _clamp(hash);
+    }
+
+    /**
+     * Starts loading the home index slot of the given hash code into the cache, for a find that follows
+     * @param hash - hash code of a key
+     */
+    void prefetch(size_t hash) const
+    {
+        prefetchAddress(&_slots[bucketIndex(hash)]);
+    }
+
+    /**
+     * @param key - key value, or a value of any type the (transparent) hash function accepts
+     * @param hash - hash code of the key
+     * @return position of the entry holding the key, end() if the key is not in the table
+     */
+    template<class K>
+    Position find(const K & key, size_t hash) const
+    {
+        size_t index = bucketIndex(hash);
+        unsigned int fingerprint = _fingerprint(hash);
+
+        // once we pass a pair that is closer to its home than we are to ours, the key can not be further
+        for (unsigned int distance = 1; _slots[index].distance >= distance; distance++)
+        {
+            const Slot & slot = _slots[index];
+            if (slot.fingerprint == fingerprint and _entries[slot.entry].hashMatches(hash) and
+                _equal(_pairAt(slot.entry)->first, key))
+            {
+                return {slot.entry, 0};
+            }
+            index = _clamp(index + 1);
+        }
+        return end();
+    }
+
+    /**
+     * Adds a pair whose key is known not to be in the table after the last entry, the index must have a free
+     * slot
+     * @param pair - (key,value) to add
+     * @param hash - hash code of the key
+     * @return position of the stored pair
+     */
+    Position insertNew(tuple && pair, size_t hash)
+    {
+        if (_count == _entryCapacity)
+        {
+            _growEntries(std::max<size_t>(1, _entryCapacity * ENTRY_GROWTH_FACTOR));
+        }
+        size_t entry = _count;
+        new(_entries[entry].storage) tuple(std::move(pair));
+        _entries[entry].storeHash(hash);
+        _count++;
+        _index(entry, hash);
+        return {entry, 0};
+    }
+
+    /**
+     * Moves every pair of the given table into this one (re-hashing), in the order of its entries, using the
+     * stored hash codes (if kept) instead of hashing the keys again; the pairs are moved and never compared,
+     * as they are known to be distinct.
+     * @param source - table to empty
+     */
+    void takeAll(DenseTable & source)
+    {
+        if (_entryCapacity < _count + source._count)
+        {
+            _growEntries(_count + source._count);
+        }
+        for (size_t i = 0; i < source._count; i++)
+        {
+            insertNew(std::move(*source._pairAt(i)), source._hashAt(i));
+            source._pairAt(i)->~tuple();
+        }
+        source._count = 0;
+        for (size_t i = 0; i < source._capacity; i++)
+        {
+            source._slots[i].distance = FREE_INDEX_SLOT;
+        }
+    }
+
+    /**
+     * Moves the pair of one index slot of the given table into this one (one step of an incremental re-hash),
+     * along with the pairs backward-shift pulls into that slot
+     * @param source - table to move the pairs from
+     * @param index - the index slot in the source table
+     * @return number of pairs moved
+     */
+    size_t takeBucket(DenseTable & source, size_t index)
+    {
+        size_t moved = 0;
+        while (source._slots[index].distance != FREE_INDEX_SLOT)
+        {
+            takeFrom(source, {source._slots[index].entry, 0});
+            moved++;
+        }
+        return moved;
+    }
+
+    /**
+     * Moves one pair of the given table into this one, erasing it from the source
+     * @param source - table to move the pair from
+     * @param position - position of the pair in the source table
+     * @return position of the pair in this table
+     */
+    Position takeFrom(DenseTable & source, const Position & position)
+    {
+        Position placed = insertNew(std::move(*source._pairAt(position.bucket)), source._hashAt(position.bucket));
+        source.erase(position);
+        return placed;
+    }
+
+    /**
+     * Copies every pair of the given table into this one, which must be empty and of the same capacity, entries and index alike:
+     * the layout is cloned as it is, so no key is hashed, compared or probed for
+     * @param source - table to copy
+     */
+    void cloneFrom(const DenseTable & source)
+    {
+        if (_entryCapacity < source._count)
+        {
+            _growEntries(source._count);
+        }
+        for (; _count < source._count; _count++)
+        {
+            new(_entries[_count].storage) tuple(*source._pairAt(_count));
+            _entries[_count].copyHash(source._entries[_count]);
+        }
+        std::copy(source._slots, source._slots + _capacity, _slots);
+    }
+
+    /**
+     * Removes the pair in the given position (which must not be end()): the last entry is moved into its place
+     */
+    void erase(const Position & position)
+    {
+        size_t entry = position.bucket;
+        size_t last = _count - 1;
+        size_t index = _slotOf(entry);
+        if (entry != last)
+        {
+            // point the last entry's slot at the hole before the backward shift can move that slot
+            _slots[_slotOf(last)].entry = entry;
+        }
+        _unindex(index);
+        _pairAt(entry)->~tuple();
+        if (entry != last)
+        {
+            new(_entries[entry].storage) tuple(std::move(*_pairAt(last)));
+            _entries[entry].copyHash(_entries[last]);
+            _pairAt(last)->~tuple();
+        }
+        _count--;
+    }
+
+    /**
+     * Removes all the pairs, keeping the capacity of the index and of the entries
+     */
+    void clear()
+    {
+        for (size_t i = 0; i < _count; i++)
+        {
+            _pairAt(i)->~tuple();
+        }
+        _count = 0;
+        for (size_t i = 0; i < _capacity; i++)
+        {
+            _slots[i].distance = FREE_INDEX_SLOT;
+        }
+    }
+
+    /**
+     * @return bytes allocated by the table: the index and the entries array
+     */
+    size_t allocatedBytes() const
+    {
+        return _capacity * sizeof(Slot) + _entryCapacity * sizeof(Entry);
+    }
+
+    /**
+     * Counts every pair in a probe length histogram (see HashMapStats): a pair is found at the probe of its
+     * distance from its home slot
+     * @param histogram - the histogram to add to
+     */
+    void probeLengths(std::vector<size_t> & histogram) const
+    {
+        for (size_t i = 0; i < _capacity; i++)
+        {
+            if (_slots[i].distance != FREE_INDEX_SLOT)
+            {
+                countProbeLength(histogram, _slots[i].distance);
+            }
+        }
+    }
+
+    /**
+     * @param hash - hash code of a key
+     * @return number of pairs that share the home slot of the key
+     */
+    size_t bucketSize(size_t hash) const
+    {
+        size_t home = bucketIndex(hash);
+        size_t count = 0;
+
+        // pairs are ordered by their home slot along a cluster, so the ones sharing ours are adjacent
+        for (unsigned int offset = 1; _slots[_clamp(home + offset - 1)].distance >= offset; offset++)
+        {
+            if (_slots[_clamp(home + offset - 1)].distance == offset)
+            {
+                count++;
+            }
+        }
+        return count;
+    }
+
+    /**
+     * @return position of the first entry or end() if the table is empty
+     */
+    Position begin() const
+    {
+        return _count == 0 ? end() : Position{0, 0};
+    }
+
+    /**
+     * @return the position past the last entry, the same for every table and every capacity
+     */
+    Position end() const
+    {
+        return {END_BUCKET, 0};
+    }
+
+    /**
+     * Moves the given position to the next entry (or to end())
+     */
+    void advance(Position & position) const
+    {
+        position.bucket++;
+        if (position.bucket >= _count)
+        {
+            position = end();
+        }
+    }
+
+    /**
+     * @return the pair in the given position (which must not be end())
+     */
+    tuple & at(const Position & position) const
+    {
+        return *_pairAt(position.bucket);
+    }
+
+    /**
+     * @return the hash code of the key of the pair in the given position (which must not be end()), without
+     * hashing the key when the table keeps hash codes
+     */
+    size_t hashAt(const Position & position) const
+    {
+        return _hashAt(position.bucket);
+    }
+
+    /**
+     * This exchanges the contents of two tables
+     */
+    void swap(DenseTable & other) noexcept
+    {
+        std::swap(_capacity, other._capacity);
+        std::swap(_slots, other._slots);
+        std::swap(_entries, other._entries);
+        std::swap(_count, other._count);
+        std::swap(_entryCapacity, other._entryCapacity);
+        std::swap(_hash, other._hash);
+        std::swap(_equal, other._equal);
+        std::swap(_slotAllocator, other._slotAllocator);
+        std::swap(_entryAllocator, other._entryAllocator);
+    }
+
+private:
+
+    /**
+     * A slot of the index: the entry it points to, the probe distance of that entry's key from its home slot
+     * plus one (FREE_INDEX_SLOT if the slot is free) and the upper bits of the key's hash code
+     */
+    struct Slot
+    {
+        size_t entry;
+
+        unsigned int distance;
+
+        unsigned int fingerprint;
+    };
+
+    /**
+     * An entry: the hash code of its key (if kept) and raw storage for the pair itself
+     */
+    struct Entry : StoredHash<CacheHash>
+    {
+        alignas(tuple) unsigned char storage[sizeof(tuple)];
+    };
+
+    size_t _capacity;
+
+    Slot *_slots;
+
+    Entry *_entries;
+
+    size_t _count;
+
+    size_t _entryCapacity;
+
+    Hash _hash;
+
+    KeyEqual _equal;
+
+    typename std::allocator_traits<Allocator>::template rebind_alloc<Slot> _slotAllocator;
+
+    typename std::allocator_traits<Allocator>::template rebind_alloc<Entry> _entryAllocator;
+
+    /**
+     * Clamps hashing indices to fit within the current table capacity
+     *
+     * @param index - the index before clamping
+     * @return An index properly clamped
+     */
+    size_t _clamp(size_t index) const
+    {
+        return index & (_capacity - 1);
+    }
+
+    /**
+     * @return the bits of a hash code kept in the index slots, the ones the home slot is not taken from
+     */
+    static unsigned int _fingerprint(size_t hash)
+    {
+        return static_cast<unsigned int>(static_cast<unsigned long long>(hash) >> FINGERPRINT_SHIFT);
+    }
+
+    /**
+     * @return the pair stored in the given entry
+     */
+    tuple *_pairAt(size_t entry) const
+    {
+        return std::launder(reinterpret_cast<tuple *>(_entries[entry].storage));
+    }
+
+    /**
+     * @return the hash code of the key of the pair in the given entry
+     */
+    size_t _hashAt(size_t entry) const
+    {
+        return _entries[entry].storedHash(_hash, _pairAt(entry)->first);
+    }
+
+    /**
+     * Moves the entries into a new array of the given capacity
+     */
+    void _growEntries(size_t entryCapacity)
+    {
+        Entry *entries = _entryAllocator.allocate(entryCapacity);
+        for (size_t i = 0; i < _count; i++)
+        {
+            new(entries[i].storage) tuple(std::move(*_pairAt(i)));
+            entries[i].copyHash(_entries[i]);
+            _pairAt(i)->~tuple();
+        }
+        if (_entries != nullptr)
+        {
+            _entryAllocator.deallocate(_entries, _entryCapacity);
+        }
+        _entries = entries;
+        _entryCapacity = entryCapacity;
+    }
+
+    /**
+     * Adds the given entry to the index, Robin Hood style
+     * @param entry - the entry
+     * @param hash - hash code of its key
+     */
+    void _index(size_t entry, size_t hash)
+    {
+        Slot carried = {entry, 1, _fingerprint(hash)};
+        size_t index = bucketIndex(hash);
+
+        while (_slots[index].distance != FREE_INDEX_SLOT)
+        {
+            if (_slots[index].distance < carried.distance)
+            {
+                // the resident is closer to its home than we are: take its slot and carry it on
+                std::swap(carried, _slots[index]);
+            }
+            index = _clamp(index + 1);
+            carried.distance++;
+        }
+        _slots[index] = carried;
+    }
+
+    /**
+     * @return the index slot that points to the given entry
+     */
+    size_t _slotOf(size_t entry) const
+    {
+        size_t index = bucketIndex(_hashAt(entry));
+        while (_slots[index].entry != entry or _slots[index].distance == FREE_INDEX_SLOT)
+        {
+            index = _clamp(index + 1);
+        }
+        return index;
+    }
+
+    /**
+     * Frees the given index slot, pulling the rest of its cluster one slot towards its home (backward shift)
+     */
+    void _unindex(size_t index)
+    {
+        size_t next = _clamp(index + 1);
+        while (_slots[next].distance > 1)
+        {
+            _slots[index] = _slots[next];
+            _slots[index].distance--;
+            index = next;
+            next = _clamp(next + 1);
+        }
+        _slots[index].distance = FREE_INDEX_SLOT;
+    }
+};
+
+/**
+ * Storage policy of HashMap: pairs packed in insertion order behind a separate hash index
+ */
+struct DenseStorage
+{
+    template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator>
+    using table = DenseTable<KeyT, ValueT, Hash, KeyEqual, Allocator, CacheHashCode<KeyT>::value>;
+};
+
+#endif
@@ -0,0 +1,186 @@
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+
+
+#ifndef CPP_EX3_EPOCH_HPP
+#define CPP_EX3_EPOCH_HPP
+
+static const size_t MAX_READER_THREADS = 256;
+
+static const size_t READER_SLOT_ALIGNMENT = 64;
+
+static const uint64_t QUIESCENT = 0;
+
+static const uint64_t FIRST_EPOCH = 1;
+
+static const size_t NO_SLOT = MAX_READER_THREADS;
+
+static const char *const TOO_MANY_READERS_ERR = "Too many threads reading at once";
+
+/**
+ * Epoch based reclamation: tells a writer when memory it unlinked can no longer be reached by any reader.
+ * A reader announces the current epoch in a slot of its own while it reads (EpochGuard), and clears it
+ * when done; a writer that unlinks memory advances the epoch and may free the memory once every announced
+ * epoch is at least the advanced one - a reader that announced it started after the unlinking.
+ * Entering and leaving are a load and a store, never a wait, so readers are wait-free.
+ * There is one domain for the whole process, a thread takes a reader slot on its first read and gives it
+ * back when it exits.
+ */
+class EpochDomain
+{
+public:
+
+    /**
+     * @return the domain of the process
+     */
+    static EpochDomain & instance()
+    {
+        static EpochDomain domain;
+        return domain;
+    }
+
+    EpochDomain(const EpochDomain & other) = delete;
+
+    EpochDomain & operator=(const EpochDomain & other) = delete;
+
+    /**
+     * Starts a read: memory reachable from now on is not freed until the matching exit. Reads may nest.
+     */
+    void enter()
+    {
+        ThreadState & state = _threadState();
+        if (state.depth == 0)
+        {
+            if (state.slot == NO_SLOT)
+            {
+                state.slot = _claimSlot();
+            }
+            _slots[state.slot].epoch.store(_epoch.load());
+        }
+        state.depth++;
+    }
+
+    /**
+     * Ends the read started by the matching enter
+     */
+    void exit()
+    {
+        ThreadState & state = _threadState();
+        if (--state.depth == 0)
+        {
+            _slots[state.slot].epoch.store(QUIESCENT, std::memory_order_release);
+        }
+    }
+
+    /**
+     * Advances the epoch, to be called after unlinking memory
+     * @return the epoch to free the unlinked memory at (see isSafe)
+     */
+    uint64_t advance()
+    {
+        return _epoch.fetch_add(1) + 1;
+    }
+
+    /**
+     * @param epoch - an epoch returned by advance
+     * @return true if no reader that started before that epoch is still reading
+     */
+    bool isSafe(uint64_t epoch) const
+    {
+        for (const ReaderSlot & slot : _slots)
+        {
+            uint64_t announced = slot.epoch.load();
+            if (announced != QUIESCENT and announced < epoch)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+private:
+
+    /**
+     * The epoch a reader announced (QUIESCENT when it is not reading), on a cache line of its own
+     */
+    struct alignas(READER_SLOT_ALIGNMENT) ReaderSlot
+    {
+        std::atomic<uint64_t> epoch{QUIESCENT};
+
+        std::atomic<bool> claimed{false};
+    };
+
+    /**
+     * The reader slot of a thread and how deep its reads are nested, the slot is released when the thread exits
+     */
+    struct ThreadState
+    {
+        size_t slot = NO_SLOT;
+
+        unsigned int depth = 0;
+
+        ~ThreadState()
+        {
+            if (slot != NO_SLOT)
+            {
+                EpochDomain::instance()._slots[slot].claimed.store(false, std::memory_order_release);
+            }
+        }
+    };
+
+    std::atomic<uint64_t> _epoch;
+
+    ReaderSlot _slots[MAX_READER_THREADS];
+
+    EpochDomain() : _epoch(FIRST_EPOCH)
+    {}
+
+    static ThreadState & _threadState()
+    {
+        static thread_local ThreadState state;
+        return state;
+    }
+
+    /**
+     * @return a free reader slot, now owned by the calling thread
+     */
+    size_t _claimSlot()
+    {
+        for (size_t i = 0; i < MAX_READER_THREADS; i++)
+        {
+            bool expected = false;
+            if (!_slots[i].claimed.load(std::memory_order_relaxed) and
+                _slots[i].claimed.compare_exchange_strong(expected, true))
+            {
+                return i;
+            }
+        }
+        throw (std::length_error(TOO_MANY_READERS_ERR));
+    }
+};
+
+/**
+ * Marks a read for the lifetime of the guard (see EpochDomain::enter)
+ */
+class EpochGuard
+{
+public:
+
+    EpochGuard()
+    {
+        EpochDomain::instance().enter();
+    }
+
+    EpochGuard(const EpochGuard & other) = delete;
+
+    EpochGuard & operator=(const EpochGuard & other) = delete;
+
+    ~EpochGuard()
+    {
+        EpochDomain::instance().exit();
+    }
+};
+
+#endif
@@ -0,0 +1,481 @@
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "KeyHash.hpp"
+
+
+#ifndef CPP_EX3_FROZENHASHMAP_HPP
+#define CPP_EX3_FROZENHASHMAP_HPP
+
+static const char FROZEN_MAGIC[8] = {'H', 'M', 'F', 'R', 'O', 'Z', 'E', 'N'};
+
+static const uint32_t FROZEN_VERSION = 1;
+
+static const uint32_t FROZEN_BYTE_ORDER = 0x01020304;
+
+static const uint64_t FROZEN_SEED = 0x5eed5eed5eed5eedull;
+
+static const uint64_t FROZEN_EMPTY_SLOT = UINT64_MAX;
+
+static const size_t FROZEN_LOAD_DIVISOR = 2;
+
+static const char *const FROZEN_FILE_ERR = "Not a frozen hash map file (or written with another value type)";
+
+static const char *const FROZEN_WRITE_ERR = "Failed to write the frozen hash map file";
+
+static const char *const FROZEN_NOT_CONTAIN_ERR = "Frozen map dose not contain the key";
+
+/**
+ * The header at the start of a frozen hash map file. All the positions in the file are offsets from its
+ * start, so the file can be mapped at any address and shared by any number of processes.
+ * The layout is: header, slots (the hash index: open addressing with linear probing, at most half full),
+ * string pool (the bytes of all the keys, one after the other).
+ */
+struct FrozenHeader
+{
+    char magic[sizeof(FROZEN_MAGIC)];
+
+    uint32_t version;
+
+    uint32_t byteOrder;
+
+    uint64_t seed;
+
+    uint64_t size;
+
+    uint64_t capacity;
+
+    uint64_t slotSize;
+
+    uint64_t valueSize;
+
+    uint64_t slotsOffset;
+
+    uint64_t poolOffset;
+
+    uint64_t poolSize;
+};
+
+template<class ValueT>
+/**
+ * A slot of the hash index of a frozen hash map: the hash code of its key, where the key is in the string pool
+ * (keyOffset is FROZEN_EMPTY_SLOT if the slot is free) and the value itself
+ * @tparam ValueT - represents a value for the map
+ */
+struct FrozenSlot
+{
+    uint64_t hash;
+
+    uint64_t keyOffset;
+
+    uint64_t keyLength;
+
+    ValueT value;
+};
+
+template<class Map>
+/**
+ * Writes a map with string keys (std::string or std::string_view) into a frozen hash map file,
+ * to be opened by FrozenHashMap<Map::mapped_type>
+ * @param map - the map to freeze
+ * @param path - path of the file to write
+ * @param seed - seed of the hash function of the index (WyHash, the same on every run and every machine)
+ */
+void freeze(const Map & map, const std::string & path, uint64_t seed = FROZEN_SEED)
+{
+    using ValueT = typename Map::mapped_type;
+    using Slot = FrozenSlot<ValueT>;
+    static_assert(std::is_trivially_copyable<ValueT>::value, "frozen values are copied as raw bytes");
+
+    size_t count = 0;
+    for (auto iterator = map.begin(); iterator != map.end(); ++iterator)
+    {
+        count++;
+    }
+    size_t capacity = 1;
+    while (capacity < count * FROZEN_LOAD_DIVISOR + 1)
+    {
+        capacity <<= 1;
+    }
+
+    WyHash hash(seed);
+    std::vector<Slot> slots(capacity);
+    for (Slot & slot : slots)
+    {
+        slot.keyOffset = FROZEN_EMPTY_SLOT;
+    }
+    std::string pool;
+    for (const auto & pair : map)
+    {
+        std::string_view key(pair.first);
+        uint64_t code = hash(key);
+        size_t index = code & (capacity - 1);
+        while (slots[index].keyOffset != FROZEN_EMPTY_SLOT)
+        {
+            index = (index + 1) & (capacity - 1);
+        }
+        slots[index].hash = code;
+        slots[index].keyOffset = pool.size();
+        slots[index].keyLength = key.size();
+        slots[index].value = pair.second;
+        pool.append(key.data(), key.size());
+    }
+
+    FrozenHeader header = {};
+    std::memcpy(header.magic, FROZEN_MAGIC, sizeof(FROZEN_MAGIC));
+    header.version = FROZEN_VERSION;
+    header.byteOrder = FROZEN_BYTE_ORDER;
+    header.seed = seed;
+    header.size = count;
+    header.capacity = capacity;
+    header.slotSize = sizeof(Slot);
+    header.valueSize = sizeof(ValueT);
+    header.slotsOffset = (sizeof(FrozenHeader) + alignof(Slot) - 1) / alignof(Slot) * alignof(Slot);
+    header.poolOffset = header.slotsOffset + capacity * sizeof(Slot);
+    header.poolSize = pool.size();
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    for (size_t i = sizeof(header); i < header.slotsOffset; i++)
+    {
+        file.put(0);
+    }
+    file.write(reinterpret_cast<const char *>(slots.data()), static_cast<std::streamsize>(capacity * sizeof(Slot)));
+    file.write(pool.data(), static_cast<std::streamsize>(pool.size()));
+    file.close();
+    if (!file)
+    {
+        throw (std::runtime_error(FROZEN_WRITE_ERR));
+    }
+}
+
+template<class ValueT>
+/**
+ * A read-only hash map with string keys, answered straight from a file written by freeze: the file is
+ * mapped into memory and never parsed, so opening it costs the same for any size, only the pages a lookup
+ * touches are read, and processes that open the same file share its pages in the page cache.
+ * The file is trusted to have been written by freeze for the same ValueT and the same byte order, which
+ * the header is checked for.
+ * @tparam ValueT - represents a value for the map, trivially copyable
+ */
+class FrozenHashMap
+{
+    using Slot = FrozenSlot<ValueT>;
+
+public:
+
+    /**
+     * iterator to the map, it yields (key, value) pairs by value
+     */
+    class Iterator
+    {
+    public:
+
+        typedef std::pair<std::string_view, ValueT> value_type;
+        typedef value_type reference;
+        typedef const value_type *pointer;
+        typedef std::ptrdiff_t difference_type;
+        typedef std::forward_iterator_tag iterator_category;
+
+        Iterator(const FrozenHashMap *map, size_t index) : _map(map), _index(index)
+        {
+            _skipEmpty();
+        }
+
+        value_type operator*() const
+        {
+            const Slot & slot = _map->_slots[_index];
+            return value_type(_map->_keyOf(slot), slot.value);
+        }
+
+        Iterator & operator++()
+        {
+            _index++;
+            _skipEmpty();
+            return *this;
+        }
+
+        Iterator operator++(int)
+        {
+            Iterator previous = *this;
+            ++*this;
+            return previous;
+        }
+
+        bool operator==(const Iterator & other) const
+        {
+            return _map == other._map and _index == other._index;
+        }
+
+        bool operator!=(const Iterator & other) const
+        {
+            return !(*this == other);
+        }
+
+    private:
+
+        const FrozenHashMap *_map;
+
+        size_t _index;
+
+        void _skipEmpty()
+        {
+            while (_index < _map->_capacity and _map->_slots[_index].keyOffset == FROZEN_EMPTY_SLOT)
+            {
+                _index++;
+            }
+        }
+    };
+
+    typedef Iterator const_iterator;
+
+    /**
+     * Maps the given file
+     * @param path - path of a file written by freeze
+     */
+    explicit FrozenHashMap(const std::string & path);
+
+    FrozenHashMap(const FrozenHashMap & other) = delete;
+
+    FrozenHashMap & operator=(const FrozenHashMap & other) = delete;
+
+    /**
+     * Destructor, unmaps the file
+     */
+    ~FrozenHashMap();
+
+    /**
+     * @param path - path of a file
+     * @return true if the file starts like a frozen hash map file
+     */
+    static bool isFrozen(const std::string & path);
+
+    /**
+     * @return True if the given key contained in the map and false otherwise
+     */
+    bool containsKey(std::string_view key) const;
+
+    /**
+     * @param key - key value
+     * @return the value of the key, stored in the mapped file
+     */
+    const ValueT & at(std::string_view key) const;
+
+    /**
+     * @return number of pairs in the map
+     */
+    size_t size() const;
+
+    /**
+     * @return true if the map is empty and false otherwise
+     */
+    bool empty() const;
+
+    /**
+     * @return number of slots of the hash index
+     */
+    size_t capacity() const;
+
+    const_iterator begin() const;
+
+    const_iterator end() const;
+
+private:
+
+    const char *_file;
+
+    size_t _fileSize;
+
+    const Slot *_slots;
+
+    const char *_pool;
+
+    size_t _size;
+
+    size_t _capacity;
+
+    size_t _poolSize;
+
+    WyHash _hash;
+
+    /**
+     * @return the slot of the key, nullptr if the key is not in the map
+     */
+    const Slot *_find(std::string_view key) const;
+
+    /**
+     * @return the key of an occupied slot, a view into the string pool
+     */
+    std::string_view _keyOf(const Slot & slot) const;
+
+    /**
+     * Checks that the header fits the file and describes a map of this ValueT, throws otherwise
+     */
+    static const FrozenHeader & _validHeader(const char *file, size_t fileSize);
+};
+
+//=================FrozenHashMap implementation==================//
+
+template<class ValueT>
+FrozenHashMap<ValueT>::FrozenHashMap(const std::string & path) : _file(nullptr), _fileSize(0)
+{
+    int descriptor = ::open(path.c_str(), O_RDONLY);
+    if (descriptor < 0)
+    {
+        throw (std::invalid_argument(FROZEN_FILE_ERR));
+    }
+    struct stat status;
+    if (::fstat(descriptor, &status) != 0 or static_cast<size_t>(status.st_size) < sizeof(FrozenHeader))
+    {
+        ::close(descriptor);
+        throw (std::invalid_argument(FROZEN_FILE_ERR));
+    }
+    _fileSize = static_cast<size_t>(status.st_size);
+    void *mapping = ::mmap(nullptr, _fileSize, PROT_READ, MAP_SHARED, descriptor, 0);
+    ::close(descriptor);
+    if (mapping == MAP_FAILED)
+    {
+        throw (std::invalid_argument(FROZEN_FILE_ERR));
+    }
+    _file = static_cast<const char *>(mapping);
+
+    try
+    {
+        const FrozenHeader & header = _validHeader(_file, _fileSize);
+        _slots = reinterpret_cast<const Slot *>(_file + header.slotsOffset);
+        _pool = _file + header.poolOffset;
+        _size = header.size;
+        _capacity = header.capacity;
+        _poolSize = header.poolSize;
+        _hash = WyHash(header.seed);
+    }
+    catch (...)
+    {
+        ::munmap(const_cast<char *>(_file), _fileSize);
+        throw;
+    }
+}
+
+template<class ValueT>
+FrozenHashMap<ValueT>::~FrozenHashMap()
+{
+    ::munmap(const_cast<char *>(_file), _fileSize);
+}
+
+template<class ValueT>
+bool FrozenHashMap<ValueT>::isFrozen(const std::string & path)
+{
+    std::ifstream file(path, std::ios::binary);
+    char magic[sizeof(FROZEN_MAGIC)];
+    return file.read(magic, sizeof(magic)) and std::memcmp(magic, FROZEN_MAGIC, sizeof(magic)) == 0;
+}
+
+template<class ValueT>
+bool FrozenHashMap<ValueT>::containsKey(std::string_view key) const
+{
+    return _find(key) != nullptr;
+}
+
+template<class ValueT>
+const ValueT & FrozenHashMap<ValueT>::at(std::string_view key) const
+{
+    const Slot *slot = _find(key);
+    if (slot == nullptr)
+    {
+        throw (std::invalid_argument(FROZEN_NOT_CONTAIN_ERR));
+    }
+    return slot->value;
+}
+
+template<class ValueT>
+size_t FrozenHashMap<ValueT>::size() const
+{
+    return _size;
+}
+
+template<class ValueT>
+bool FrozenHashMap<ValueT>::empty() const
+{
+    return _size == 0;
+}
+
+template<class ValueT>
+size_t FrozenHashMap<ValueT>::capacity() const
+{
+    return _capacity;
+}
+
+template<class ValueT>
+typename FrozenHashMap<ValueT>::const_iterator FrozenHashMap<ValueT>::begin() const
+{
+    return Iterator(this, 0);
+}
+
+template<class ValueT>
+typename FrozenHashMap<ValueT>::const_iterator FrozenHashMap<ValueT>::end() const
+{
+    return Iterator(this, _capacity);
+}
+
+template<class ValueT>
+const typename FrozenHashMap<ValueT>::Slot *FrozenHashMap<ValueT>::_find(std::string_view key) const
+{
+    uint64_t code = _hash(key);
+    // the index is at most half full, so probing always reaches a free slot
+    for (size_t index = code & (_capacity - 1);; index = (index + 1) & (_capacity - 1))
+    {
+        const Slot & slot = _slots[index];
+        if (slot.keyOffset == FROZEN_EMPTY_SLOT)
+        {
+            return nullptr;
+        }
+        if (slot.hash == code and _keyOf(slot) == key)
+        {
+            return &slot;
+        }
+    }
+}
+
+template<class ValueT>
+std::string_view FrozenHashMap<ValueT>::_keyOf(const Slot & slot) const
+{
+    if (slot.keyOffset > _poolSize or slot.keyLength > _poolSize - slot.keyOffset)
+    {
+        throw (std::invalid_argument(FROZEN_FILE_ERR));
+    }
+    return std::string_view(_pool + slot.keyOffset, slot.keyLength);
+}
+
+template<class ValueT>
+const FrozenHeader & FrozenHashMap<ValueT>::_validHeader(const char *file, size_t fileSize)
+{
+    const FrozenHeader & header = *reinterpret_cast<const FrozenHeader *>(file);
+    bool valid = std::memcmp(header.magic, FROZEN_MAGIC, sizeof(FROZEN_MAGIC)) == 0 and
+                 header.version == FROZEN_VERSION and header.byteOrder == FROZEN_BYTE_ORDER and
+                 header.slotSize == sizeof(Slot) and header.valueSize == sizeof(ValueT) and
+                 header.slotsOffset % alignof(Slot) == 0 and
+                 header.capacity != 0 and (header.capacity & (header.capacity - 1)) == 0 and
+                 header.size < header.capacity and header.slotsOffset >= sizeof(FrozenHeader) and
+                 header.slotsOffset <= fileSize and header.capacity <= (fileSize - header.slotsOffset) / sizeof(Slot) and
+                 header.poolOffset == header.slotsOffset + header.capacity * sizeof(Slot) and
+                 header.poolOffset <= fileSize and header.poolSize <= fileSize - header.poolOffset;
+    if (!valid)
+    {
+        throw (std::invalid_argument(FROZEN_FILE_ERR));
+    }
+    return header;
+}
+
+#endif
@@ -1,43 +1,54 @@
 #include <vector>
 #include <set>
 #include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iterator>
 #include <cassert>
 #include <exception>
 #include <stdexcept>
+#include <tuple>
+#include <optional>
+#include <utility>
+#include "KeyHash.hpp"
+#include "Arena.hpp"
+#include "HashMapStats.hpp"
+#include "ChainedTable.hpp"
+#include "RobinHoodTable.hpp"
+#include "SwissTable.hpp"
+#include "DenseTable.hpp"
+#include "BloomFilter.hpp"
 
 
 #ifndef CPP_EX3_HASHMAP_HPP
 #define CPP_EX3_HASHMAP_HPP
 
-const int DEFAULT_CAPACITY = 1;
+const size_t DEFAULT_CAPACITY = 1;
 
-const int INITIAL_CAPACITY = 16;
+const size_t INITIAL_CAPACITY = 16;
 
 const double DEFAULT_HIGHER_CAPACITY = 0.75;
 
 const double DEFAULT_LOWER_CAPACITY = 0.25;
 
-const int QUADRATIC_FACTOR = 2;
+const size_t QUADRATIC_FACTOR = 2;
 
-const int EMPTY_SET = 0;
+const size_t EMPTY_SET = 0;
 
 const bool TO_ADD = true;
 
 const bool TO_DELETE = false;
 
-static const int DEFAULT_SIZE = 0;
+static const size_t DEFAULT_SIZE = 0;
 
 static const char *const INVALID_MSG = "Invalid input\n";
 
-static const char *const USAGE_MSG = "Usage: SpamDetector <database path> <message path> <threshold>\n";
+static const char *const USAGE_MSG = "Usage: SpamDetector <database path> <message path> <threshold>\n"
+                                       "       SpamDetector --freeze <database path> <frozen database path>\n";
 
-static const int NO_ELEMENTS = 0;
+static const size_t NO_ELEMENTS = 0;
 
-static const int ONE_PAIR_SIZE = 1;
-
-static const bool CHECK_KEY_ONLY = true;
-
-static const bool CHECK_KEY_AND_VALUE = false;
+static const size_t ONE_PAIR_SIZE = 1;
 
 static const char *const FACTOR_RANGE_ERR = "Lower Load Factor or Upper Load Factor out of range";
 
@@ -45,20 +56,44 @@ static const char *const CAPACITY_VEC_ERR = "Capacities of the vectors must br e
 
 static const char *const NOT_CONTAIN_ERR = "Table dose not contain the key";
 
+static const char *const FILTER_RATE_ERR = "False positive rate of a negative filter must be in [0, 1)";
+
+static const size_t ALL_AT_ONCE = 0;
+
+static const double REHASH_DONE = 1.0;
+
+static const size_t LOOKUP_BATCH = 16;
+
+static const double NO_FILTER = 0;
+
+/**
+ * Share of the most pairs the table holds that the negative filter keeps room for beyond the keys it is built
+ * with, so a map churning at a steady size rebuilds it at most once per that many inserts
+ */
+static const double FILTER_SPARE = 0.25;
+
 
 
 
-template<class KeyT, class ValueT>
+template<class KeyT, class ValueT, class Hash = KeyHash<KeyT>, class KeyEqual = std::equal_to<>,
+        class Allocator = std::allocator<std::pair<KeyT, ValueT>>, class Storage = ChainedStorage>
 /**
  *A hash map container made up of (key,value) pairs, which can be
  * retrieved based on a key.
  * @tparam KeyT - represents a key for the map
  * @tparam ValueT - represents a value for the map
+ * @tparam Hash - hash function of the keys (KeyHash by default, see KeyHash.hpp for WyHash and FnvHash)
+ * @tparam KeyEqual - equality of the keys
+ * @tparam Allocator - allocator of the pairs, rebound by the table to its own node types
+ * @tparam Storage - storage policy, the layout of the table: ChainedStorage (separate chaining),
+ * RobinHoodStorage (open addressing), SwissStorage (open addressing with SIMD group probing) or DenseStorage
+ * (pairs packed in insertion order behind a hash index)
  */
 class HashMap
 {
-    using bucket = std::vector<std::pair<KeyT, ValueT>>;
     using tuple = std::pair<KeyT, ValueT>;
+    using table = typename Storage::template table<KeyT, ValueT, Hash, KeyEqual, Allocator>;
+    using position = typename table::Position;
 
     /**
      * iterator to the map
@@ -67,23 +102,22 @@ class HashMap
     {
     public:
         /**
-         *Default Constructor
+         *Default Constructor, an iterator of no map
          */
-        Iterator() = default;
+        Iterator() : _hashMap(nullptr), _position{END_BUCKET, 0}, _inOldTable(false)
+        {}
 
         /**
          * Constructor
          * @param hashMap - the table
-         * @param pair - (key,value)
-         * @param pairNum - pair index in current bucket
-         * @param buckNum - current bucket number
+         * @param pos - position of the current pair in the table
+         * @param inOldTable - true if the position is in the table that is still being re-hashed from
          */
-        Iterator(const HashMap<KeyT, ValueT> *hashMap, tuple *pair, unsigned int pairNum, int buckNum)
+        Iterator(const HashMap *hashMap, position pos, bool inOldTable = false)
         {
             _hashMap = hashMap;
-            _pair = pair;
-            _pairNum = pairNum;
-            _numOfBucket = buckNum;
+            _position = pos;
+            _inOldTable = inOldTable;
         }
 
         /**
@@ -92,7 +126,7 @@ class HashMap
          */
         const tuple & operator*() const
         {
-            return *_pair;
+            return _currentTable().at(_position);
         }
 
         /**
@@ -113,8 +147,8 @@ class HashMap
         /**
          *Operator -> overload
          */
-        const tuple *operator->()
-        { return &(*_pair); }
+        const tuple *operator->() const
+        { return &(**this); }
 
         /**
          *Operator != overload
@@ -129,61 +163,287 @@ class HashMap
 
     private:
 
-        tuple *_pair;
+        friend class HashMap;
+
+        const HashMap *_hashMap;
+
+        position _position;
+
+        bool _inOldTable;
+
+        /**
+         * @return the table the current position belongs to
+         */
+        const table & _currentTable() const
+        {
+            return _inOldTable ? _hashMap->_oldTable : _hashMap->_table;
+        }
+    };
+
+    /**
+     * A pair taken out of a map by extract, owned by no map, that insert puts into a map (this one or another
+     * one of the same type). The key and the value are moved in and out, never copied.
+     */
+    class NodeHandle
+    {
+    public:
+        /**
+         * Default Constructor, an empty node
+         */
+        NodeHandle() = default;
+
+        NodeHandle(const NodeHandle & other) = delete;
+
+        NodeHandle & operator=(const NodeHandle & other) = delete;
 
-        const HashMap<KeyT, ValueT> *_hashMap;
+        NodeHandle(NodeHandle && other) noexcept = default;
 
-        unsigned int _pairNum;
+        NodeHandle & operator=(NodeHandle && other) noexcept = default;
+
+        /**
+         * @return true if the node holds no pair
+         */
+        bool empty() const
+        {
+            return !_pair.has_value();
+        }
 
-        int _numOfBucket;
+        /**
+         * @return true if the node holds a pair
+         */
+        explicit operator bool() const
+        {
+            return _pair.has_value();
+        }
 
         /**
-         * Set the index of the next bucket
+         * @return the key of the pair (which must be there), it may be changed before inserting the node
          */
-        void _setNextBucket();
+        KeyT & key() const
+        {
+            return _pair->first;
+        }
 
         /**
-         * Set the index of the next bucket
+         * @return the value of the pair (which must be there)
          */
-        void _setNextPair();
+        ValueT & mapped() const
+        {
+            return _pair->second;
+        }
+
+    private:
+
+        friend class HashMap;
+
+        mutable std::optional<tuple> _pair;
+
+        explicit NodeHandle(tuple && pair) : _pair(std::move(pair))
+        {}
+    };
+
+    /**
+     * What insert of a node returns: where the key is, whether the node has been inserted, and the node
+     * itself back when its key was already in the map
+     */
+    struct InsertReturn
+    {
+        Iterator position;
 
+        bool inserted;
 
+        NodeHandle node;
     };
 
 private:
 
-    int _currentCapacity;
+    template<class, class, class, class, class, class> friend
+    class ConcurrentHashMap;
 
-    int _size;
+    size_t _size;
 
     double _lowerLoadFactor;
 
     double _upperLoadFactor;
 
-    bucket *_hashSet;
+    table _table;
+
+    table _oldTable;
+
+    table _nextTable;
+
+    size_t _rehashCursor;
+
+    size_t _prepareCursor;
+
+    size_t _rehashStep;
+
+    size_t _reservedCapacity;
+
+    size_t _rehashes;
+
+    double _rehashSeconds;
+
+    BlockedBloomFilter _filter;
+
+    double _filterRate;
+
+    size_t _filterKeys;
+
+    size_t _filterCodes;
+
+#ifdef HASHMAP_COUNTERS
+    OperationCounters _counters;
+#endif
 
+    /**
+     * Counts an operation for stats, when compiled with HASHMAP_COUNTERS
+     * @param operation - the kind of operation
+     * @param hit - true if the operation found its key
+     */
+    void _count(OperationCounters::Operation operation, bool hit) const
+    {
+#ifdef HASHMAP_COUNTERS
+        _counters.count(operation, hit);
+#else
+        (void) operation;
+        (void) hit;
+#endif
+    }
 
     /**
-   * Clamps hashing indices to fit within the current table capacity
-   *
-   * @param index - the index before clamping
-   * @return An index properly clamped
-   */
-    int _clamp(int index) const;
+     * @return false if the negative filter (when there is one) rules the hash code out, so the key need not
+     * be looked for in the tables
+     */
+    bool _filterAdmits(size_t hash) const
+    {
+        return _filterRate == NO_FILTER or _filter.mayContain(hash);
+    }
+
+    /**
+     * Adds the hash code of a new key to the negative filter, when there is one, and rebuilds the filter once
+     * it holds more hash codes than it was sized for: erased keys are never taken out of it, so inserts and
+     * erases at a steady size would otherwise fill it up without any re-hash
+     */
+    void _filterAdd(size_t hash)
+    {
+        if (_filterRate != NO_FILTER)
+        {
+            _filter.add(hash);
+            if (++_filterCodes > _filterKeys)
+            {
+                _rebuildFilter();
+            }
+        }
+    }
+
+    /**
+     * Sizes the negative filter (when there is one) for the most pairs the current capacity holds, or for the
+     * current pairs and FILTER_SPARE of that when they are more, and adds the hash codes of all the keys, in
+     * both tables while an incremental re-hash is in progress
+     */
+    void _rebuildFilter();
 
     /**
      * This method is given a capacity that fits to the new size of the Hash table
-     * and creates new hash set with that capacity and re-adding the data according to the new parameters.
+     * and creates new hash set with that capacity and moves the data to it according to the new parameters,
+     * using the hash codes stored in the old table.
+     * In incremental mode the old table is kept aside and its buckets are moved a few at a time
+     * by the following updates, and a growth takes the next table the updates before it prepared
+     * (see setIncrementalRehash).
      * @param newCapacity - new capacity of the hash set
      */
-    void _reHash(int newCapacity);
+    void _reHash(size_t newCapacity);
+
+    /**
+     * @param capacity - capacity of the table (0 for an empty table that holds no memory)
+     * @return an empty table sharing the hash function, key equality and allocator of the map
+     */
+    table _newTable(size_t capacity) const;
+
+    /**
+     * @return true if an incremental re-hash is in progress (there are pairs left in the old table)
+     */
+    bool _isRehashing() const;
+
+    /**
+     * One step of incremental re-hashing, on every update: moves the next buckets of the old table into the
+     * current one (releasing the old table once it has been fully moved), and once the map is close enough to
+     * its growth, marks the next slots of the table it will grow into empty. A step does at least _rehashStep
+     * buckets or slots, and more when the inserts left before the growth would not be enough for the rest.
+     */
+    void _rehashStepForward();
+
+    /**
+     * @return the number of inserts the table takes before its load goes over the upper load factor
+     */
+    size_t _insertsBeforeGrowth() const;
+
+    /**
+     * @param key - key value (or any type the hash function accepts)
+     * @param hash - hash code of the key
+     * @return pointer to the pair holding the key in either table, nullptr if the key is not in the map
+     */
+    template<class K>
+    tuple *_lookup(const K & key, size_t hash) const;
+
+    /**
+     * The implementation of find for any type the hash function accepts
+     */
+    template<class K>
+    Iterator _find(const K & key) const;
+
+    /**
+     * The implementation of find_batch and contains_batch
+     * @param output - called as output(index, pair) for every key, with the pair holding it or nullptr
+     */
+    template<class K, class Output>
+    void _lookupBatch(const K *keys, size_t count, Output output) const;
+
+    /**
+     * The implementation of erase for any type the hash function accepts
+     */
+    template<class K>
+    bool _erase(const K & key);
+
+    /**
+     * _erase for a key whose hash code (_table.hashOf(key)) the caller already has
+     */
+    template<class K>
+    bool _erase(const K & key, size_t hash);
 
     /**
-     * This method adds data to the new HashSet after Re-Hashing
-     * @param oldTable -pointer to the old hash set before re-hashing
-     * @param oldCapacity- The capacity of the old table
+     * The implementation of extract for any type the hash function accepts
      */
-    void _addItemsToNewTable(const bucket *oldTable, const int oldCapacity);
+    template<class K>
+    NodeHandle _extract(const K & key);
+
+    /**
+     * Moves the pair in the given position out of the given table (the current or the old one) into a node
+     * and erases it
+     */
+    NodeHandle _extractAt(table & from, const position & pos);
+
+    /**
+     * Accounts for a pair just erased: the size goes down, and the table shrinks when its load falls below
+     * the lower load factor
+     */
+    void _afterErase();
+
+    /**
+     * @param count - number of pairs
+     * @return the capacity that holds the given number of pairs without passing the upper load factor
+     */
+    size_t _capacityFor(size_t count) const;
+
+    /**
+     * Shrinking hysteresis: the table shrinks to a capacity in which the load is at most halfway between the
+     * lower and the upper load factors, so a few inserts right after a shrink can never make it grow back
+     * (and a few erases right after a growth can never make it shrink back).
+     * Never goes below the capacity set by reserve.
+     * @return the capacity the table should shrink to (the current one if it should not shrink)
+     */
+    size_t _shrinkCapacity() const;
 
     /**
      * This method is given a key and value and getting the pair : (key,value)
@@ -191,38 +451,89 @@ private:
      * @param key - key to get
      * @return the pair (key,value)
      */
-    std::pair<KeyT, ValueT> & _getTuple(const KeyT & key) const;
+    template<class K>
+    std::pair<KeyT, ValueT> & _getTuple(const K & key) const;
+
+    /**
+     * The single probe every insertion is built on: hashes the key once, looks it up once and, only if it is
+     * missing, constructs the pair in place (re-hashing first when the table is about to get too full)
+     * @param key - key to look up, forwarded into the new pair if it is added
+     * @param args - arguments to construct the value from if the key is added
+     * @return the position of the pair holding the key and true if the pair has been added
+     */
+    template<class K, class... Args>
+    std::pair<position, bool> _tryEmplace(K && key, Args && ... args);
+
+    /**
+     * A hash code (_table.hashOf(key)) already computed by the caller, given first to _tryEmplace so it is not
+     * taken for a key
+     */
+    struct KnownHash
+    {
+        size_t value;
+    };
+
+    /**
+     * _tryEmplace for a key whose hash code the caller already has, like ConcurrentHashMap after picking a shard
+     */
+    template<class K, class... Args>
+    std::pair<position, bool> _tryEmplace(KnownHash hash, K && key, Args && ... args);
 
     /**
-   * This method checks if the current load factor is out of it's boundaries the check is done according
-   * to the action that is currently occurring
+   * This method checks if the load factor is out of it's boundaries the check is done according
+   * to the action that is currently occurring: before adding a pair it checks the load the table would have
+   * with one more pair, after deleting a pair it checks the current load
    *
    * @param addFlag - a flag that indicates if the current action is either add or delete
-   * @return true if the current loadFactor is out of it's boundaries.
+   * @return true if the loadFactor is out of it's boundaries.
    */
     bool _checkCapacity(bool addFlag) const;
 
     /**
-
-     * @param pair  - pair of (KeyT,ValueT)
-     * @param keyOnly - flag whether to check if only the key contained in one of the buckets
-     * or the and it's value
-     * @return key only is true: true if the key contains in it's bucket and false otherwise
-     *          if pair : true if the pair contained in it's bucket and false otherwise
+     * @param source - a table of another map
+     * @return true if every pair of the given table is in this map, with an equal value
      */
-    bool _isInBucket(const std::pair<KeyT, ValueT> & pair, bool keyOnly) const;
+    bool _containsPairsOf(const table & source) const;
 
 
 public:
 
     typedef Iterator const_iterator;
 
+    typedef KeyT key_type;
+
+    typedef ValueT mapped_type;
+
+    typedef Hash hasher;
+
+    typedef KeyEqual key_equal;
+
+    typedef Allocator allocator_type;
+
+    typedef NodeHandle node_type;
+
+    typedef InsertReturn insert_return_type;
+
 
     /**
      * Default Constructor
      */
     HashMap();
 
+    /**
+     * Constructs an empty hash map with default capacity and factors, using the given functors and allocator
+     * @param hash - hash function of the keys, e.g. a seeded WyHash
+     * @param equal - equality of the keys
+     * @param allocator - allocator of the pairs
+     */
+    explicit HashMap(const Hash & hash, const KeyEqual & equal = KeyEqual(), const Allocator & allocator = Allocator());
+
+    /**
+     * Constructs an empty hash map with default capacity and factors, using the given allocator
+     * @param allocator - allocator of the pairs
+     */
+    explicit HashMap(const Allocator & allocator);
+
     /**
      * Constructs a new hash map with default capacity and the given factors
      *
@@ -234,13 +545,31 @@ public:
     /**
      *Constructor : given two vectors of the same size - called n
      * and creates hash map such that for all 0<= i < n keys[i] |-> values[i]
+     * (a key that appears more than once is mapped to its last value).
+     * The table is sized once for n pairs.
      * @param keys - vector of KeyT
      * @param values - vector of ValueT
      */
-    HashMap(std::vector<KeyT> keys, std::vector<ValueT> values);
+    HashMap(const std::vector<KeyT> & keys, const std::vector<ValueT> & values);
+
+    /**
+     * Same as the constructor above, moving the keys and the values into the map
+     */
+    HashMap(std::vector<KeyT> && keys, std::vector<ValueT> && values);
 
     /**
-     * Copy Constructor
+     * Constructs a map from a range of (key,value) pairs, a key that appears more than once keeps its first
+     * value. When the range can be measured up front (forward iterators) the table is sized once for it.
+     * @param first - iterator to the first pair
+     * @param last - iterator past the last pair
+     */
+    template<class InputIt, class = typename std::iterator_traits<InputIt>::iterator_category>
+    HashMap(InputIt first, InputIt last);
+
+    /**
+     * Copy Constructor, the copy has the capacity of the given map. Unless the given map is in the middle of
+     * an incremental re-hash its table is cloned slot by slot (see cloneFrom of the tables), without hashing
+     * or probing for any key.
      */
     HashMap(const HashMap & other);
 
@@ -258,13 +587,14 @@ public:
     /**
   * operator = overload
   */
-    HashMap<KeyT, ValueT> & operator=(HashMap other);
+    HashMap & operator=(const HashMap & other);
 
     HashMap & operator=(HashMap && other) noexcept;
 
     /**
-    * operator == overload
-    */
+     * operator == overload, two maps are equal if they hold the same keys with equal values, whatever their
+     * capacities and layouts
+     */
     bool operator==(const HashMap & other) const;
 
     /**
@@ -294,11 +624,105 @@ public:
      */
     bool insert(const KeyT & key, const ValueT & val);
 
+    /**
+     * Adds the assignment (key|->ValueT(args...)) if the key is not in the map, the value is not
+     * constructed (and args are left untouched) if it is
+     * @param key - key to add
+     * @param args - arguments to construct the value from
+     * @return iterator to the pair holding the key and true if the pair has been added
+     */
+    template<class... Args>
+    std::pair<const_iterator, bool> try_emplace(const KeyT & key, Args && ... args);
+
+    /**
+     * try_emplace that moves the key into the map when it is added
+     */
+    template<class... Args>
+    std::pair<const_iterator, bool> try_emplace(KeyT && key, Args && ... args);
+
+    /**
+     * Constructs a (key,value) pair from the given arguments and adds it if its key is not in the map
+     * @param args - arguments to construct the pair from
+     * @return iterator to the pair holding the key and true if the pair has been added
+     */
+    template<class... Args>
+    std::pair<const_iterator, bool> emplace(Args && ... args);
+
+    /**
+     * Adds the assignment (key|->val), or assigns val to the key if it is already in the map
+     * @param key - key to add or update
+     * @param val - the value
+     * @return iterator to the pair holding the key and true if the pair has been added (false if assigned)
+     */
+    template<class M>
+    std::pair<const_iterator, bool> insert_or_assign(const KeyT & key, M && val);
+
+    /**
+     * insert_or_assign that moves the key into the map when it is added
+     */
+    template<class M>
+    std::pair<const_iterator, bool> insert_or_assign(KeyT && key, M && val);
+
+    /**
+     * @param key - key value
+     * @return iterator to the pair holding the key, end() if the key is not in the map
+     */
+    const_iterator find(const KeyT & key) const;
+
+    /**
+     * find by a value of another type, e.g. a std::string_view or a const char* for std::string keys.
+     * Available when the hash function and the key equality are transparent
+     * (the default ones are for std::string), no KeyT is built.
+     */
+    template<class K, class H = hasher, class E = key_equal, class = typename H::is_transparent,
+            class = typename E::is_transparent>
+    const_iterator find(const K & key) const;
+
     /**
      * @return True if the given key contained in the map and false otherwise
      */
     bool containsKey(const KeyT & key) const;
 
+    /**
+     * containsKey by a value of another type, available when the hash function and the key equality are transparent
+     */
+    template<class K, class H = hasher, class E = key_equal, class = typename H::is_transparent,
+            class = typename E::is_transparent>
+    bool containsKey(const K & key) const;
+
+    /**
+     * Looks up many keys at once: hashes LOOKUP_BATCH keys, starts loading the slot of each of them into the
+     * cache and only then compares the keys, so the cache misses of the batch overlap instead of following
+     * each other. Faster than calling find in a loop once the table no longer fits in the cache.
+     * @param keys - the keys to look up
+     * @param count - number of keys
+     * @param values - set to a pointer to the value of every key, nullptr for a key not in the map
+     */
+    void find_batch(const KeyT *keys, size_t count, const ValueT **values) const;
+
+    /**
+     * find_batch by values of another type, available when the hash function and the key equality are transparent
+     */
+    template<class K, class H = hasher, class E = key_equal, class = typename H::is_transparent,
+            class = typename E::is_transparent>
+    void find_batch(const K *keys, size_t count, const ValueT **values) const;
+
+    /**
+     * containsKey of many keys at once (see find_batch)
+     * @param keys - the keys to look up
+     * @param count - number of keys
+     * @param found - set to true for every key in the map and to false for the others
+     */
+    void contains_batch(const KeyT *keys, size_t count, bool *found) const;
+
+    /**
+     * contains_batch by values of another type, available when the hash function and the key equality are
+     * transparent
+     */
+    template<class K, class H = hasher, class E = key_equal, class = typename H::is_transparent,
+            class = typename E::is_transparent>
+    void contains_batch(const K *keys, size_t count, bool *found) const;
+
     /**
      * This method is given a key and tries to erase the the pair which contains it
      * @param key - KeyT
@@ -306,28 +730,94 @@ public:
      */
     bool erase(const KeyT & key);
 
+    /**
+     * erase by a value of another type, available when the hash function and the key equality are transparent
+     */
+    template<class K, class H = hasher, class E = key_equal, class = typename H::is_transparent,
+            class = typename E::is_transparent>
+    bool erase(const K & key);
+
+    /**
+     * Takes the pair holding the given key out of the map, moving the key and the value into a node and
+     * erasing the pair (the table may shrink, as with erase)
+     * @param key - key value
+     * @return the node holding the pair, an empty node if the key is not in the map
+     */
+    node_type extract(const KeyT & key);
+
+    /**
+     * extract by a value of another type, available when the hash function and the key equality are transparent
+     */
+    template<class K, class H = hasher, class E = key_equal, class = typename H::is_transparent,
+            class = typename E::is_transparent>
+    node_type extract(const K & key);
+
+    /**
+     * Takes the pair the given iterator points to out of the map (see extract)
+     * @param where - iterator to a pair of this map (not end())
+     * @return the node holding the pair
+     */
+    node_type extract(const_iterator where);
+
+    /**
+     * Puts the pair of a node into the map, moving its key and value in, if its key is not in the map
+     * @param node - node from extract (of this map or of another one of the same type), may be empty
+     * @return iterator to the pair holding the key (end() for an empty node), true if the node has been
+     * inserted, and the node itself (untouched) if it has not
+     */
+    insert_return_type insert(node_type && node);
+
+    /**
+     * Moves every pair of the other map whose key is not in this map into this map: the table is sized once
+     * for both maps, the pairs are moved (never copied) and every key is hashed at most once (not at all when
+     * the hash function is stateless and the other table keeps hash codes). The pairs whose keys are already
+     * in this map stay in the other one, which is sized for them once at the end.
+     * @param other - map to move the pairs from
+     */
+    void merge(HashMap & other);
+
+    /**
+     * merge from a map that is about to be destroyed
+     */
+    void merge(HashMap && other);
+
     /**
      * This methods clears the hash set from elements
      */
     void clear();
 
     /**
-     *  This method is given a key and returns it's bucket index in the set and -1 if it has not been found
+     *  This method is given a key and returns the index of the bucket it belongs to in the set
      * @param key - key value
-     * @return returns it's bucket index in the set and -1 if it has not been found
+     * @return the bucket index of the key, whether or not the key is in the set
      */
-    int getKeyIndex(const KeyT & key) const;
+    size_t getKeyIndex(const KeyT & key) const;
 
     /**
     *@return The current capacity (number of cells) of the table.
     */
-    int capacity() const;
+    size_t capacity() const;
+
+    /**
+     * @return the hash function of the map
+     */
+    hasher hash_function() const;
+
+    /**
+     * @return the key equality of the map
+     */
+    key_equal key_eq() const;
+
+    /**
+     * @return the allocator of the map
+     */
+    allocator_type get_allocator() const;
 
     /**
      * @param key - key which contained in a pair within the hash set
      * @return The size of the key's bucket size
      */
-    int bucketSize(const KeyT & key);
+    size_t bucketSize(const KeyT & key);
 
     /**
      * This method is given key which contained in a pair within the hash set and returns
@@ -337,6 +827,13 @@ public:
      */
     ValueT & at(const KeyT & key) const;
 
+    /**
+     * at by a value of another type, available when the hash function and the key equality are transparent
+     */
+    template<class K, class H = hasher, class E = key_equal, class = typename H::is_transparent,
+            class = typename E::is_transparent>
+    ValueT & at(const K & key) const;
+
     /**
      * @return true if the table is empty and false otherwise
      */
@@ -347,10 +844,73 @@ public:
      */
     double getLoadFactor() const;
 
+    /**
+     * Walks the whole table to describe it: sizes and bytes allocated, the probe length histogram, re-hashes
+     * and their time, and (when compiled with HASHMAP_COUNTERS) hits and misses per operation.
+     * Takes time linear in the capacity, meant to be sampled, not called on every operation.
+     * @return the statistics of the map
+     */
+    HashMapStats stats() const;
+
+    /**
+     * Makes room for the given number of pairs, so adding them does not re-hash.
+     * The reserved capacity is kept as a floor: erase never shrinks the table below it.
+     * @param count - number of pairs to make room for
+     */
+    void reserve(size_t count);
+
+    /**
+     * Re-hashes the table into a capacity of at least the given one (and at least the one the current pairs
+     * need), this also clears any tombstones left by erase
+     * @param count - the requested capacity
+     */
+    void rehash(size_t count);
+
+    /**
+     * Switches incremental re-hashing on or off. When on, no single update pays for the whole map when it
+     * grows: as the map gets close to its upper load factor, every update (insert, erase, operator[] and the
+     * like) marks a few slots of the larger table empty, the growth itself only swaps that table in, and every
+     * update after it moves a few buckets of the old table into it. Until the move is done lookups check both
+     * tables. Lookups are const and do not move buckets themselves, see finishRehash.
+     * An update does at least bucketsPerStep buckets (or slots) of this work, and more when fewer inserts are
+     * left before the next growth than bucketsPerStep would need: at least the work left divided by the inserts
+     * left, so the old table is always moved out before the next table is prepared, and that one before the
+     * map grows again. With a small bucketsPerStep the updates right after a growth do a few times more.
+     * Shrinking, rehash, reserve, merge and the re-hash in the same capacity that clears tombstones still build
+     * their table in one call, and so does the negative filter (see setNegativeFilter) on every re-hash.
+     * @param bucketsPerStep - least number of buckets to move (or slots to prepare) on every update,
+     * ALL_AT_ONCE (0) to re-hash the whole table in one call (the default), which also completes a re-hash in
+     * progress
+     */
+    void setIncrementalRehash(size_t bucketsPerStep);
+
+    /**
+     * Completes an incremental re-hash in progress, if any
+     */
+    void finishRehash();
+
+    /**
+     * Puts a negative filter in front of the table: a blocked Bloom filter of the hash codes of the keys
+     * (BloomFilter.hpp), checked by find, containsKey, at and the batched lookups before any probe, so most
+     * lookups of missing keys cost one hash and one cache line of the filter. Inserts add to the filter and
+     * every re-hash rebuilds it for the new capacity; erased keys stay in it, as false positives, until the
+     * next rebuild, which also comes once the filter holds more hash codes than it was sized for, as it does
+     * after enough inserts and erases at a steady size.
+     * @param falsePositiveRate - the fraction of lookups of missing keys let through to the table, NO_FILTER
+     * (0) to remove the filter (the default)
+     */
+    void setNegativeFilter(double falsePositiveRate);
+
+    /**
+     * @return the fraction of the old table already moved by the incremental re-hash in progress
+     * (REHASH_DONE when there is none)
+     */
+    double rehashProgress() const;
+
     /**
      * @return the size of the collection(the numbers of values)
      */
-    int size() const;
+    size_t size() const;
 
     /**
      * @return a read iterator that points to the first pair in the
@@ -358,7 +918,8 @@ public:
     const Iterator begin() const;
 
     /**
-     * @return a read iterator that points to the last pair in the
+     * @return a read iterator past the last pair in the map, which does not depend on the capacity (nor change
+     * with re-hashing)
      */
     const Iterator end() const;
 
@@ -371,7 +932,7 @@ public:
     }
 
     /**
-     * @return a read iterator that points to the last pair in the
+     * @return a read iterator past the last pair in the map
      */
     const Iterator cend() const
     {
@@ -385,18 +946,30 @@ public:
 
 //Constructors and Destructor:
 
-template<class KeyT, class ValueT>
-HashMap<KeyT, ValueT>::HashMap()
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::HashMap() : HashMap(Hash())
+{
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::HashMap(const Hash & hash, const KeyEqual & equal, const Allocator & allocator) :
+        _table(table::validCapacity(INITIAL_CAPACITY), hash, equal, allocator), _oldTable(0, hash, equal, allocator),
+        _nextTable(0, hash, equal, allocator), _rehashCursor(0), _prepareCursor(0), _rehashStep(ALL_AT_ONCE),
+        _reservedCapacity(0), _rehashes(0), _rehashSeconds(0),
+        _filterRate(NO_FILTER), _filterKeys(0), _filterCodes(0)
 {
-    _currentCapacity = INITIAL_CAPACITY;
     _lowerLoadFactor = DEFAULT_LOWER_CAPACITY;
     _upperLoadFactor = DEFAULT_HIGHER_CAPACITY;
     _size = NO_ELEMENTS;
-    _hashSet = new bucket[_currentCapacity];
 }
 
-template<class KeyT, class ValueT>
-HashMap<KeyT, ValueT>::HashMap(double lowerFactor, double upperFactor):HashMap()
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::HashMap(const Allocator & allocator) : HashMap(Hash(), KeyEqual(), allocator)
+{
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::HashMap(double lowerFactor, double upperFactor):HashMap()
 {
 
     if (lowerFactor > upperFactor or lowerFactor <= 0 or upperFactor >= 1)
@@ -408,392 +981,1072 @@ HashMap<KeyT, ValueT>::HashMap(double lowerFactor, double upperFactor):HashMap()
 
 }
 
-template<class KeyT, class ValueT>
-HashMap<KeyT, ValueT>::HashMap(std::vector<KeyT> keys, std::vector<ValueT> values):HashMap()
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::HashMap(const std::vector<KeyT> & keys, const std::vector<ValueT> & values):HashMap()
 {
 
     if (keys.size() != values.size())
     {
         throw std::invalid_argument(CAPACITY_VEC_ERR);
     }
+    rehash(_capacityFor(keys.size()));
 
-    for (int i = 0; i < keys.size(); i++)
+    for (size_t i = 0; i < keys.size(); i++)
     {
-        (*this)[keys[i]] = values[i];
+        insert_or_assign(keys[i], values[i]);
     }
 
 }
 
-template<class KeyT, class ValueT>
-HashMap<KeyT, ValueT>::HashMap(const HashMap & other)
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::HashMap(std::vector<KeyT> && keys, std::vector<ValueT> && values):HashMap()
 {
 
-    _currentCapacity = other._currentCapacity;
-    _upperLoadFactor = other._upperLoadFactor;
+    if (keys.size() != values.size())
+    {
+        throw std::invalid_argument(CAPACITY_VEC_ERR);
+    }
+    rehash(_capacityFor(keys.size()));
+
+    for (size_t i = 0; i < keys.size(); i++)
+    {
+        insert_or_assign(std::move(keys[i]), std::move(values[i]));
+    }
+
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+template<class InputIt, class>
+HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::HashMap(InputIt first, InputIt last):HashMap()
+{
+    using category = typename std::iterator_traits<InputIt>::iterator_category;
+    if (std::is_base_of<std::forward_iterator_tag, category>::value)
+    {
+        rehash(_capacityFor(static_cast<size_t>(std::distance(first, last))));
+    }
+
+    for (; first != last; ++first)
+    {
+        emplace(*first);
+    }
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::HashMap(const HashMap & other) :
+        _table(other._table.capacity(), other._table.hashFunction(), other._table.keyEqual(),
+               std::allocator_traits<Allocator>::select_on_container_copy_construction(other._table.allocator())),
+        _oldTable(_newTable(0)), _nextTable(_newTable(0)), _rehashCursor(0), _prepareCursor(0),
+        _rehashStep(other._rehashStep),
+        _reservedCapacity(other._reservedCapacity), _rehashes(0), _rehashSeconds(0), _filter(other._filter),
+        _filterRate(other._filterRate), _filterKeys(other._filterKeys), _filterCodes(other._filterCodes)
+{
+
+    _upperLoadFactor = other._upperLoadFactor;
     _lowerLoadFactor = other._lowerLoadFactor;
-    _size = NO_ELEMENTS;
-    _hashSet = new bucket[_currentCapacity];
+    _size = other._size;
 
-    try
+    if (!other._isRehashing())
     {
-        for (auto pair: other)
-        {
-            insert(pair.first, pair.second);
-        }
+        _table.cloneFrom(other._table);
+        return;
     }
-    catch (...)
+    // the keys of the given map are distinct, so they are added without looking them up first
+    for (const tuple & pair : other)
     {
-        delete[] _hashSet;
-        throw;
+        _table.insertNew(tuple(pair), _table.hashOf(pair.first));
     }
 }
 
-template<class KeyT, class ValueT>
-HashMap<KeyT, ValueT>::~HashMap()
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::~HashMap()
 {
-    delete[] _hashSet;
+    // the table prepared for the next growth may have slots that were never made empty
+    _nextTable.releaseEmpty();
+    _prepareCursor = 0;
 }
 
 
 
 //Operators Overload:
 
-template<class KeyT, class ValueT>
-HashMap<KeyT, ValueT> & HashMap<KeyT, ValueT>::operator=(HashMap other)
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage> & HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::operator=(const HashMap & other)
 {
-    swap(other);
+    HashMap copy(other);
+    swap(copy);
     return *this;
 }
 
-template<class KeyT, class ValueT>
-bool HashMap<KeyT, ValueT>::operator==(const HashMap & other) const
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+bool HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::operator==(const HashMap & other) const
 {
-    if (_currentCapacity != other.capacity() or _size != other._size)
+    if (&other == this)
     {
-        return false;
+        return true;
     }
-    for (auto pair:other)
+    if (_size != other._size)
     {
-        if (!_isInBucket(pair, CHECK_KEY_AND_VALUE))
-        {
-            return false;
-        }
+        return false;
     }
-    return true;
+    // with as many pairs on both sides, finding every pair of the other map here is enough
+    return _containsPairsOf(other._table) and (!other._isRehashing() or _containsPairsOf(other._oldTable));
 }
 
-template<class KeyT, class ValueT>
-bool HashMap<KeyT, ValueT>::operator!=(const HashMap & other) const
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+bool HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::operator!=(const HashMap & other) const
 {
     return !(*this == other);
 }
 
-template<class KeyT, class ValueT>
-const ValueT & HashMap<KeyT, ValueT>::operator[](const KeyT & key) const
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+const ValueT & HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::operator[](const KeyT & key) const
 {
     return at(key);
 }
 
-template<class KeyT, class ValueT>
-ValueT & HashMap<KeyT, ValueT>::operator[](const KeyT & key)
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+ValueT & HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::operator[](const KeyT & key)
 {
-    if (!containsKey(key))
-    {
-        insert(key, ValueT());
-    }
-    return at(key);
+    return _table.at(_tryEmplace(key).first).second;
 }
 
-template<class KeyT, class ValueT>
-HashMap<KeyT, ValueT> & HashMap<KeyT, ValueT>::operator=(HashMap && other) noexcept
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage> & HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::operator=(HashMap && other) noexcept
 {
     swap(other);
-    *this;
+    return *this;
 }
 
 
 //Other Public Methods:
 
-template<class KeyT, class ValueT>
-int HashMap<KeyT, ValueT>::getKeyIndex(const KeyT & key) const
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+size_t HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::getKeyIndex(const KeyT & key) const
+{
+    return _table.bucketIndex(_table.hashOf(key));
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+bool HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::containsKey(const KeyT & key) const
 {
-    return _clamp(std::hash<KeyT>{}(key));
+    return _lookup(key, _table.hashOf(key)) != nullptr;
 }
 
-template<class KeyT, class ValueT>
-bool HashMap<KeyT, ValueT>::containsKey(const KeyT & key) const
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+template<class K, class H, class E, class, class>
+bool HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::containsKey(const K & key) const
 {
-    return _isInBucket(std::make_pair(key, ValueT()), CHECK_KEY_ONLY);
+    return _lookup(key, _table.hashOf(key)) != nullptr;
 }
 
-template<class KeyT, class ValueT>
-bool HashMap<KeyT, ValueT>::insert(const KeyT & key, const ValueT & val)
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+bool HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::insert(const KeyT & key, const ValueT & val)
 {
-    if (containsKey(key))
+    return _tryEmplace(key, val).second;
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+template<class... Args>
+std::pair<typename HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::const_iterator, bool>
+HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::try_emplace(const KeyT & key, Args && ... args)
+{
+    auto result = _tryEmplace(key, std::forward<Args>(args)...);
+    return std::make_pair(HashMap::Iterator(this, result.first), result.second);
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+template<class... Args>
+std::pair<typename HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::const_iterator, bool>
+HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::try_emplace(KeyT && key, Args && ... args)
+{
+    auto result = _tryEmplace(std::move(key), std::forward<Args>(args)...);
+    return std::make_pair(HashMap::Iterator(this, result.first), result.second);
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+template<class... Args>
+std::pair<typename HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::const_iterator, bool>
+HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::emplace(Args && ... args)
+{
+    tuple pair(std::forward<Args>(args)...);
+    return try_emplace(std::move(pair.first), std::move(pair.second));
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+template<class M>
+std::pair<typename HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::const_iterator, bool>
+HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::insert_or_assign(const KeyT & key, M && val)
+{
+    auto result = _tryEmplace(key, std::forward<M>(val));
+    if (!result.second)
     {
-        return false;
+        _table.at(result.first).second = std::forward<M>(val);
     }
+    return std::make_pair(HashMap::Iterator(this, result.first), result.second);
+}
 
-    _hashSet[getKeyIndex(key)].push_back(tuple(key, val));
-    _size++;
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+template<class M>
+std::pair<typename HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::const_iterator, bool>
+HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::insert_or_assign(KeyT && key, M && val)
+{
+    auto result = _tryEmplace(std::move(key), std::forward<M>(val));
+    if (!result.second)
+    {
+        _table.at(result.first).second = std::forward<M>(val);
+    }
+    return std::make_pair(HashMap::Iterator(this, result.first), result.second);
+}
 
-    if (_checkCapacity(TO_ADD))
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+typename HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::const_iterator HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::find(const KeyT & key) const
+{
+    return _find(key);
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+template<class K, class H, class E, class, class>
+typename HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::const_iterator HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::find(const K & key) const
+{
+    return _find(key);
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+void HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::find_batch(const KeyT *keys, size_t count, const ValueT **values) const
+{
+    _lookupBatch(keys, count, [values](size_t index, const tuple *pair)
     {
-        _reHash(capacity() * QUADRATIC_FACTOR);
+        values[index] = pair == nullptr ? nullptr : &pair->second;
+    });
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+template<class K, class H, class E, class, class>
+void HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::find_batch(const K *keys, size_t count, const ValueT **values) const
+{
+    _lookupBatch(keys, count, [values](size_t index, const tuple *pair)
+    {
+        values[index] = pair == nullptr ? nullptr : &pair->second;
+    });
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+void HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::contains_batch(const KeyT *keys, size_t count, bool *found) const
+{
+    _lookupBatch(keys, count, [found](size_t index, const tuple *pair)
+    {
+        found[index] = pair != nullptr;
+    });
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+template<class K, class H, class E, class, class>
+void HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::contains_batch(const K *keys, size_t count, bool *found) const
+{
+    _lookupBatch(keys, count, [found](size_t index, const tuple *pair)
+    {
+        found[index] = pair != nullptr;
+    });
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+template<class K, class Output>
+void HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::_lookupBatch(const K *keys, size_t count, Output output) const
+{
+    size_t hashes[LOOKUP_BATCH];
+    for (size_t first = 0; first < count; first += LOOKUP_BATCH)
+    {
+        size_t batch = std::min(LOOKUP_BATCH, count - first);
+        for (size_t i = 0; i < batch; i++)
+        {
+            hashes[i] = _table.hashOf(keys[first + i]);
+            if (_filterRate != NO_FILTER)
+            {
+                _filter.prefetch(hashes[i]);
+            }
+            _table.prefetch(hashes[i]);
+        }
+        for (size_t i = 0; i < batch; i++)
+        {
+            output(first + i, _lookup(keys[first + i], hashes[i]));
+        }
     }
-    return true;
 }
 
-template<class KeyT, class ValueT>
-int HashMap<KeyT, ValueT>::capacity() const
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+template<class K>
+typename HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::Iterator HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::_find(const K & key) const
+{
+    size_t hash = _table.hashOf(key);
+    if (!_filterAdmits(hash))
+    {
+        _count(OperationCounters::LOOKUP, false);
+        return end();
+    }
+    position pos = _table.find(key, hash);
+    if (pos == _table.end() and _isRehashing())
+    {
+        position oldPos = _oldTable.find(key, hash);
+        if (!(oldPos == _oldTable.end()))
+        {
+            _count(OperationCounters::LOOKUP, true);
+            return HashMap::Iterator(this, oldPos, true);
+        }
+    }
+    _count(OperationCounters::LOOKUP, !(pos == _table.end()));
+    return HashMap::Iterator(this, pos);
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+size_t HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::capacity() const
+{
+    return _table.capacity();
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+typename HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::hasher HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::hash_function() const
+{
+    return _table.hashFunction();
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+typename HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::key_equal HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::key_eq() const
+{
+    return _table.keyEqual();
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+typename HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::allocator_type HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::get_allocator() const
 {
-    return _currentCapacity;
+    return _table.allocator();
 }
 
-template<class KeyT, class ValueT>
-int HashMap<KeyT, ValueT>::bucketSize(const KeyT & key)
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+size_t HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::bucketSize(const KeyT & key)
 {
 
-    if (!containsKey(key))
+    size_t hash = _table.hashOf(key);
+    if (!(_table.find(key, hash) == _table.end()))
     {
-        throw (std::invalid_argument(NOT_CONTAIN_ERR));
+        return _table.bucketSize(hash);
+    }
+    if (_isRehashing() and !(_oldTable.find(key, hash) == _oldTable.end()))
+    {
+        return _oldTable.bucketSize(hash);
     }
-    return static_cast<int>(_hashSet[getKeyIndex(key)].size());
+    throw (std::invalid_argument(NOT_CONTAIN_ERR));
 }
 
-template<class KeyT, class ValueT>
-bool HashMap<KeyT, ValueT>::erase(const KeyT & key)
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+bool HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::erase(const KeyT & key)
 {
-    if (!containsKey(key))
+    return _erase(key);
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+template<class K, class H, class E, class, class>
+bool HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::erase(const K & key)
+{
+    return _erase(key);
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+template<class K>
+bool HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::_erase(const K & key)
+{
+    return _erase(key, _table.hashOf(key));
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+template<class K>
+bool HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::_erase(const K & key, size_t hash)
+{
+    _rehashStepForward();
+    position pos = _table.find(key, hash);
+    if (!(pos == _table.end()))
+    {
+        _table.erase(pos);
+    }
+    else if (_isRehashing() and !((pos = _oldTable.find(key, hash)) == _oldTable.end()))
     {
+        _oldTable.erase(pos);
+    }
+    else
+    {
+        _count(OperationCounters::ERASE, false);
         return false;
     }
-    int currIndex = getKeyIndex(key);
-    auto it = std::find(_hashSet[currIndex].begin(), _hashSet[currIndex].end(), _getTuple(key));
+    _count(OperationCounters::ERASE, true);
+    _afterErase();
+    return true;
+}
 
-    _hashSet[currIndex].erase(it, it + 1);
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+void HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::_afterErase()
+{
     _size--;
 
     if (_checkCapacity(TO_DELETE))
     {
-        _reHash(capacity() / QUADRATIC_FACTOR);
+        size_t newCapacity = _shrinkCapacity();
+        if (newCapacity < _table.capacity())
+        {
+            _reHash(newCapacity);
+        }
     }
-    return true;
 }
 
-template<class KeyT, class ValueT>
-void HashMap<KeyT, ValueT>::clear()
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+typename HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::node_type HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::extract(const KeyT & key)
 {
-    for (int i = 0; i < _currentCapacity; i++)
+    return _extract(key);
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+template<class K, class H, class E, class, class>
+typename HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::node_type HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::extract(const K & key)
+{
+    return _extract(key);
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+typename HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::node_type HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::extract(const_iterator where)
+{
+    _count(OperationCounters::ERASE, true);
+    return _extractAt(where._inOldTable ? _oldTable : _table, where._position);
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+template<class K>
+typename HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::node_type HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::_extract(const K & key)
+{
+    _rehashStepForward();
+    size_t hash = _table.hashOf(key);
+    position pos = _table.find(key, hash);
+    if (!(pos == _table.end()))
     {
-        _hashSet[i].clear();
+        _count(OperationCounters::ERASE, true);
+        return _extractAt(_table, pos);
     }
-    _size = DEFAULT_SIZE;
+    if (_isRehashing() and !((pos = _oldTable.find(key, hash)) == _oldTable.end()))
+    {
+        _count(OperationCounters::ERASE, true);
+        return _extractAt(_oldTable, pos);
+    }
+    _count(OperationCounters::ERASE, false);
+    return node_type();
 }
 
-template<class KeyT, class ValueT>
-ValueT & HashMap<KeyT, ValueT>::at(const KeyT & key) const
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+typename HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::node_type HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::_extractAt(table & from, const position & pos)
 {
-    return _getTuple(key).second;
+    node_type node(std::move(from.at(pos)));
+    from.erase(pos);
+    _afterErase();
+    return node;
 }
 
-template<class KeyT, class ValueT>
-const typename HashMap<KeyT, ValueT>::Iterator HashMap<KeyT, ValueT>::begin() const
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+typename HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::insert_return_type HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::insert(node_type && node)
 {
-    int numOfBucket = 0;
+    if (node.empty())
+    {
+        return {end(), false, node_type()};
+    }
+    auto result = _tryEmplace(std::move(node._pair->first), std::move(node._pair->second));
+    if (!result.second)
+    {
+        return {HashMap::Iterator(this, result.first), false, std::move(node)};
+    }
+    node._pair.reset();
+    return {HashMap::Iterator(this, result.first), true, node_type()};
+}
 
-    while (numOfBucket < capacity() and _hashSet[numOfBucket].empty())
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+void HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::merge(HashMap & other)
+{
+    if (&other == this or other._size == 0)
+    {
+        return;
+    }
+    finishRehash();
+    other.finishRehash();
+    if (_capacityFor(_size + other._size + _table.tombstones()) > _table.capacity())
     {
-        ++numOfBucket;
+        // merge moves every pair anyway, so the re-hash is completed here even in incremental mode
+        _reHash(_capacityFor(_size + other._size));
+        finishRehash();
+    }
 
-        if (numOfBucket >= capacity())
+    // the other table is walked once, without erasing from it: its pairs are moved out (leaving moved-from
+    // pairs behind), and the ones whose keys are here are moved at the end into a table of their own sized
+    // for them, which replaces it
+    std::vector<position> kept;
+    position batch[LOOKUP_BATCH];
+    size_t hashes[LOOKUP_BATCH];
+    position pos = other._table.begin();
+    while (!(pos == other._table.end()))
+    {
+        // as in find_batch, the buckets of a batch of pairs are loaded into the cache before any of them is used
+        size_t count = 0;
+        for (; count < LOOKUP_BATCH and !(pos == other._table.end()); count++, other._table.advance(pos))
+        {
+            // a stateless hash function gives both maps the same hash codes, so the ones the other table keeps
+            // are reused and a key that is not here is never read
+            batch[count] = pos;
+            hashes[count] = std::is_empty<Hash>::value ? other._table.hashAt(pos) :
+                            _table.hashOf(other._table.at(pos).first);
+            _table.prefetch(hashes[count]);
+        }
+        for (size_t i = 0; i < count; i++)
         {
-            return end();
+            tuple & pair = other._table.at(batch[i]);
+            if (_table.find(pair.first, hashes[i]) == _table.end())
+            {
+                _count(OperationCounters::INSERT, false);
+                _table.insertNew(std::move(pair), hashes[i]);
+                _filterAdd(hashes[i]);
+                _size++;
+            }
+            else
+            {
+                _count(OperationCounters::INSERT, true);
+                kept.push_back(batch[i]);
+            }
         }
     }
-    return HashMap::Iterator(this, _hashSet[numOfBucket].data(), ONE_PAIR_SIZE, numOfBucket);
+
+    table left = other._newTable(std::max(other._capacityFor(kept.size()), other._reservedCapacity));
+    for (const position & keptPos : kept)
+    {
+        size_t hash = other._table.hashAt(keptPos);
+        left.insertNew(std::move(other._table.at(keptPos)), hash);
+    }
+    other._table.swap(left);
+    other._size = kept.size();
+    other._nextTable.releaseEmpty();
+    other._prepareCursor = 0;
 }
 
-template<class KeyT, class ValueT>
-const typename HashMap<KeyT, ValueT>::Iterator HashMap<KeyT, ValueT>::end() const
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+void HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::merge(HashMap && other)
 {
-    bucket *last = _hashSet + (capacity() - 1);
+    merge(other);
+}
 
-    int lastSize = static_cast<int>(last->size());
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+void HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::clear()
+{
+    _table.clear();
+    _newTable(0).swap(_oldTable);
+    _rehashCursor = 0;
+    _size = DEFAULT_SIZE;
+    _filter.clear();
+    _filterCodes = 0;
+}
 
-    return HashMap::Iterator(this, last->data(), static_cast<unsigned int>(capacity()), lastSize);
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+ValueT & HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::at(const KeyT & key) const
+{
+    return _getTuple(key).second;
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+template<class K, class H, class E, class, class>
+ValueT & HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::at(const K & key) const
+{
+    return _getTuple(key).second;
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+const typename HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::Iterator HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::begin() const
+{
+    if (_isRehashing() and !(_oldTable.begin() == _oldTable.end()))
+    {
+        return HashMap::Iterator(this, _oldTable.begin(), true);
+    }
+    return HashMap::Iterator(this, _table.begin());
+}
 
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+const typename HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::Iterator HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::end() const
+{
+    return HashMap::Iterator(this, _table.end());
 }
 
-template<class KeyT, class ValueT>
-bool HashMap<KeyT, ValueT>::empty() const
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+bool HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::empty() const
 {
     return size() == 0;
 }
 
-template<class KeyT, class ValueT>
-int HashMap<KeyT, ValueT>::size() const
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+size_t HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::size() const
 {
     return _size;
 }
 
-template<class KeyT, class ValueT>
-double HashMap<KeyT, ValueT>::getLoadFactor() const
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+double HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::getLoadFactor() const
 {
     return ((double) (_size) / double(capacity()));
 }
 
-template<class KeyT, class ValueT>
-void HashMap<KeyT, ValueT>::swap(HashMap & other) noexcept
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+HashMapStats HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::stats() const
+{
+    HashMapStats stats;
+    stats.size = _size;
+    stats.capacity = capacity();
+    stats.loadFactor = getLoadFactor();
+    stats.tombstones = _table.tombstones() + _oldTable.tombstones();
+    stats.tableBytes = _table.allocatedBytes() + _oldTable.allocatedBytes();
+    if (_prepareCursor == _nextTable.capacity())
+    {
+        stats.tableBytes += _nextTable.allocatedBytes();
+    }
+    stats.filterBytes = _filter.allocatedBytes();
+    for (const auto & pair : *this)
+    {
+        stats.keyHeapBytes += heapBytes(pair.first);
+    }
+
+    _table.probeLengths(stats.probeLengths);
+    _oldTable.probeLengths(stats.probeLengths);
+    stats.maxProbeLength = stats.probeLengths.size();
+    size_t probes = 0;
+    for (size_t i = 0; i < stats.probeLengths.size(); i++)
+    {
+        probes += (i + 1) * stats.probeLengths[i];
+    }
+    stats.meanProbeLength = _size == 0 ? 0 : (double) (probes) / double(_size);
+
+    stats.rehashes = _rehashes;
+    stats.rehashSeconds = _rehashSeconds;
+#ifdef HASHMAP_COUNTERS
+    stats.operations = _counters.snapshot();
+#endif
+    return stats;
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+void HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::reserve(size_t count)
+{
+    _reservedCapacity = _capacityFor(count);
+    if (_reservedCapacity > _table.capacity())
+    {
+        _reHash(_reservedCapacity);
+    }
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+void HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::rehash(size_t count)
+{
+    _reHash(std::max(count, _capacityFor(_size)));
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+void HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::setIncrementalRehash(size_t bucketsPerStep)
+{
+    _rehashStep = bucketsPerStep;
+    if (_rehashStep == ALL_AT_ONCE)
+    {
+        finishRehash();
+        _nextTable.releaseEmpty();
+        _prepareCursor = 0;
+    }
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+void HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::finishRehash()
+{
+    if (_isRehashing())
+    {
+        for (; _rehashCursor < _oldTable.capacity(); _rehashCursor++)
+        {
+            _table.takeBucket(_oldTable, _rehashCursor);
+        }
+        _oldTable.releaseEmpty();
+        _rehashCursor = 0;
+    }
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+void HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::setNegativeFilter(double falsePositiveRate)
+{
+    if (falsePositiveRate < NO_FILTER or falsePositiveRate >= 1)
+    {
+        throw (std::invalid_argument(FILTER_RATE_ERR));
+    }
+    _filterRate = falsePositiveRate;
+    if (_filterRate == NO_FILTER)
+    {
+        BlockedBloomFilter().swap(_filter);
+        return;
+    }
+    _rebuildFilter();
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+double HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::rehashProgress() const
+{
+    if (!_isRehashing())
+    {
+        return REHASH_DONE;
+    }
+    return ((double) (_rehashCursor) / double(_oldTable.capacity()));
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+void HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::swap(HashMap & other) noexcept
 {
-    std::swap(_hashSet, other._hashSet);
-    std::swap(_currentCapacity, other._currentCapacity);
+    _table.swap(other._table);
+    _oldTable.swap(other._oldTable);
+    _nextTable.swap(other._nextTable);
+    std::swap(_rehashCursor, other._rehashCursor);
+    std::swap(_prepareCursor, other._prepareCursor);
+    std::swap(_rehashStep, other._rehashStep);
+    std::swap(_reservedCapacity, other._reservedCapacity);
     std::swap(_lowerLoadFactor, other._lowerLoadFactor);
     std::swap(_upperLoadFactor, other._upperLoadFactor);
     std::swap(_size, other._size);
+    std::swap(_rehashes, other._rehashes);
+    std::swap(_rehashSeconds, other._rehashSeconds);
+    _filter.swap(other._filter);
+    std::swap(_filterRate, other._filterRate);
+    std::swap(_filterKeys, other._filterKeys);
+    std::swap(_filterCodes, other._filterCodes);
+#ifdef HASHMAP_COUNTERS
+    _counters.swap(other._counters);
+#endif
 }
 
 
 //Private Methods:
 
-template<class KeyT, class ValueT>
-void HashMap<KeyT, ValueT>::_addItemsToNewTable(const bucket *oldTable, const int oldCapacity)
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+bool HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::_containsPairsOf(const table & source) const
 {
-
-    for (int i = 0; i < oldCapacity; i++)
+    for (position pos = source.begin(); !(pos == source.end()); source.advance(pos))
     {
-        for (auto pair :oldTable[i])
+        // as in merge, a stateless hash function lets the hash codes the other table keeps be reused
+        const tuple & pair = source.at(pos);
+        size_t hash = std::is_empty<Hash>::value ? source.hashAt(pos) : _table.hashOf(pair.first);
+        const tuple *mine = _lookup(pair.first, hash);
+        if (mine == nullptr or !(mine->second == pair.second))
         {
-            insert(pair.first, pair.second);
+            return false;
         }
     }
+    return true;
 }
 
-template<class KeyT, class ValueT>
-bool HashMap<KeyT, ValueT>::_isInBucket(const std::pair<KeyT, ValueT> & pair, bool keyOnly) const
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+template<class K>
+std::pair<KeyT, ValueT> & HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::_getTuple(const K & key) const
 {
-    int bucketIndex = getKeyIndex(pair.first);
-    for (auto currPair:_hashSet[bucketIndex])
+    tuple *pair = _lookup(key, _table.hashOf(key));
+    if (pair == nullptr)
     {
-        if (currPair.first == pair.first)
+        throw (std::invalid_argument(NOT_CONTAIN_ERR));
+    }
+    return *pair;
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+template<class K>
+typename HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::tuple *HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::_lookup(const K & key,
+                                                                                      size_t hash) const
+{
+    if (!_filterAdmits(hash))
+    {
+        _count(OperationCounters::LOOKUP, false);
+        return nullptr;
+    }
+    position pos = _table.find(key, hash);
+    if (!(pos == _table.end()))
+    {
+        _count(OperationCounters::LOOKUP, true);
+        return &_table.at(pos);
+    }
+    if (_isRehashing())
+    {
+        pos = _oldTable.find(key, hash);
+        if (!(pos == _oldTable.end()))
         {
-            return keyOnly ? true : currPair.second == pair.second;
+            _count(OperationCounters::LOOKUP, true);
+            return &_oldTable.at(pos);
         }
     }
-    return false;
+    _count(OperationCounters::LOOKUP, false);
+    return nullptr;
 }
 
-template<class KeyT, class ValueT>
-std::pair<KeyT, ValueT> & HashMap<KeyT, ValueT>::_getTuple(const KeyT & key) const
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+template<class K, class... Args>
+std::pair<typename HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::position, bool>
+HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::_tryEmplace(K && key, Args && ... args)
 {
-    int currIndex = getKeyIndex(key);
+    size_t hash = _table.hashOf(key);
+    return _tryEmplace(KnownHash{hash}, std::forward<K>(key), std::forward<Args>(args)...);
+}
 
-    for (int i = 0; i < _hashSet[currIndex].size(); i++)
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+template<class K, class... Args>
+std::pair<typename HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::position, bool>
+HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::_tryEmplace(KnownHash knownHash, K && key,
+                                                                       Args && ... args)
+{
+    _rehashStepForward();
+    size_t hash = knownHash.value;
+    position pos = _table.find(key, hash);
+    if (!(pos == _table.end()))
     {
-        if (_hashSet[currIndex][i].first == key)
+        _count(OperationCounters::INSERT, true);
+        return std::make_pair(pos, false);
+    }
+    if (_isRehashing())
+    {
+        // the key is still in the old table: move it over so the caller gets a position in the current one
+        position oldPos = _oldTable.find(key, hash);
+        if (!(oldPos == _oldTable.end()))
         {
-            return _hashSet[currIndex][i];
+            _count(OperationCounters::INSERT, true);
+            return std::make_pair(_table.takeFrom(_oldTable, oldPos), false);
         }
     }
-    throw (std::invalid_argument(NOT_CONTAIN_ERR));
+    _count(OperationCounters::INSERT, false);
+
+    if (_checkCapacity(TO_ADD))
+    {
+        // when tombstones alone pushed the load up, re-hashing in the same capacity clears them
+        bool toGrow = ((double) (_size + 1) / double(capacity())) > _upperLoadFactor;
+        _reHash(toGrow ? capacity() * QUADRATIC_FACTOR : capacity());
+    }
+    pos = _table.insertNew(tuple(std::piecewise_construct, std::forward_as_tuple(std::forward<K>(key)),
+                                 std::forward_as_tuple(std::forward<Args>(args)...)), hash);
+    _filterAdd(hash);
+    _size++;
+    return std::make_pair(pos, true);
 }
 
-template<class KeyT, class ValueT>
-void HashMap<KeyT, ValueT>::_reHash(int newCapacity)
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+void HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::_reHash(size_t newCapacity)
 {
 
     if (newCapacity == EMPTY_SET)
     {
         newCapacity = DEFAULT_CAPACITY;
     }
-    int oldCapacity = capacity();
-    bucket *temp = _hashSet;
-    _hashSet = new bucket[newCapacity];
-    _currentCapacity = newCapacity;
-    _size = DEFAULT_SIZE;
-    try
+    finishRehash();
+    auto start = std::chrono::steady_clock::now();
+    _rehashes++;
+    size_t target = table::validCapacity(newCapacity);
+    table temp = _newTable(target == _nextTable.capacity() ? 0 : target);
+    if (temp.capacity() == 0)
+    {
+        // the table the updates before prepared, with every slot marked unless the growth came early
+        _nextTable.initializeSlots(_prepareCursor, target);
+        temp.swap(_nextTable);
+        _prepareCursor = 0;
+    }
+    else if (target != capacity())
+    {
+        _nextTable.releaseEmpty();
+        _prepareCursor = 0;
+    }
+    if (_rehashStep == ALL_AT_ONCE)
     {
-        _addItemsToNewTable(temp, oldCapacity);
+        temp.takeAll(_table);
+        _table.swap(temp);
     }
-    catch (...)
+    else
     {
-        delete[] temp;
-        throw;
+        _oldTable.swap(_table);
+        _table.swap(temp);
+        _rehashCursor = 0;
     }
-    delete[] temp;
+    _rebuildFilter();
+    _rehashSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
 }
 
-template<class KeyT, class ValueT>
-bool HashMap<KeyT, ValueT>::_checkCapacity(bool addFlag) const
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+void HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::_rebuildFilter()
 {
-    double loadFactor = ((double) (_size) / double(capacity()));
-    if (addFlag)
+    if (_filterRate == NO_FILTER)
     {
-        return loadFactor > _upperLoadFactor;
+        return;
+    }
+    size_t most = static_cast<size_t>(std::ceil((double) (capacity()) * _upperLoadFactor));
+    _filterKeys = std::max(most, _size + static_cast<size_t>(std::ceil((double) (most) * FILTER_SPARE)));
+    _filter.reset(_filterKeys, _filterRate);
+    _filterCodes = 0;
+    for (const table *from : {&_table, &_oldTable})
+    {
+        for (position pos = from->begin(); !(pos == from->end()); from->advance(pos))
+        {
+            _filter.add(from->hashAt(pos));
+            _filterCodes++;
+        }
     }
-    return loadFactor < _lowerLoadFactor;
 }
 
-template<class KeyT, class ValueT>
-int HashMap<KeyT, ValueT>::_clamp(int index) const
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+typename HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::table HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::_newTable(size_t capacity) const
 {
-    return index & (capacity() - 1);
+    return table(capacity, _table.hashFunction(), _table.keyEqual(), _table.allocator());
 }
 
-//Iterator Methods:
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+size_t HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::_capacityFor(size_t count) const
+{
+    return table::validCapacity(static_cast<size_t>(std::ceil((double) (count) / _upperLoadFactor)));
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+size_t HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::_shrinkCapacity() const
+{
+    double targetLoad = (_lowerLoadFactor + _upperLoadFactor) / QUADRATIC_FACTOR;
+    size_t needed = static_cast<size_t>(std::ceil((double) (_size) / targetLoad));
+    return std::min(_table.capacity(), table::validCapacity(std::max(needed, _reservedCapacity)));
+}
 
-template<class KeyT, class ValueT>
-typename HashMap<KeyT, ValueT>::Iterator & HashMap<KeyT, ValueT>::Iterator::operator++()
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+bool HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::_isRehashing() const
 {
-    _setNextPair();
-    _setNextBucket();
-    if (_numOfBucket >= _hashMap->capacity())
+    return _oldTable.capacity() != 0;
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+void HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::_rehashStepForward()
+{
+    if (_rehashStep == ALL_AT_ONCE)
     {
-        _pair = nullptr;
+        return;
     }
-    else
+    size_t inserts = _insertsBeforeGrowth();
+    size_t nextCapacity = table::validCapacity(capacity() * QUADRATIC_FACTOR);
+
+    // preparing starts when _rehashStep slots per insert would just be enough for the whole next table, and
+    // the old table has to be moved out before that
+    size_t prepareFrom = (nextCapacity + _rehashStep - 1) / _rehashStep;
+    bool preparing = _nextTable.capacity() != 0 or inserts <= prepareFrom;
+    size_t work = (_isRehashing() ? _oldTable.capacity() - _rehashCursor : 0) +
+                  (preparing ? nextCapacity - _prepareCursor : 0);
+    if (work == 0)
     {
-        _pair = &_hashMap->_hashSet[_numOfBucket][_pairNum];
-        _pairNum++;
+        return;
     }
-    return *this;
-}
+    auto start = std::chrono::steady_clock::now();
+    size_t budget = preparing ? inserts : inserts - prepareFrom;
+    size_t step = std::max(_rehashStep, budget == 0 ? work : (work + budget - 1) / budget);
 
-template<class KeyT, class ValueT>
-bool HashMap<KeyT, ValueT>::Iterator::operator!=(const HashMap<KeyT, ValueT>::Iterator & other) const
-{
-    if (_numOfBucket == other._numOfBucket)
+    if (_isRehashing())
     {
-        return _pairNum != other._pairNum;
+        size_t last = std::min(_rehashCursor + step, _oldTable.capacity());
+        step -= last - _rehashCursor;
+        for (; _rehashCursor < last; _rehashCursor++)
+        {
+            _table.takeBucket(_oldTable, _rehashCursor);
+        }
+        if (_rehashCursor == _oldTable.capacity())
+        {
+            _oldTable.releaseEmpty();
+            _rehashCursor = 0;
+        }
     }
-    return _pair != NULL;
+    if (preparing and !_isRehashing() and step != 0)
+    {
+        if (_nextTable.capacity() == 0)
+        {
+            // allocated untouched, its memory is only used as its slots are marked
+            table(nextCapacity, _table.hashFunction(), _table.keyEqual(), _table.allocator(),
+                  DEFER_SLOTS).swap(_nextTable);
+            _prepareCursor = 0;
+        }
+        size_t last = std::min(_prepareCursor + step, nextCapacity);
+        _nextTable.initializeSlots(_prepareCursor, last);
+        _prepareCursor = last;
+    }
+    _rehashSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
 }
 
-template<class KeyT, class ValueT>
-bool HashMap<KeyT, ValueT>::Iterator::operator==(const HashMap::Iterator & other) const
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+size_t HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::_insertsBeforeGrowth() const
 {
-    return !(*this != other);
+    size_t most = static_cast<size_t>(std::floor((double) (capacity()) * _upperLoadFactor));
+    size_t used = _size + _table.tombstones();
+    return most > used ? most - used : 0;
 }
 
-template<class KeyT, class ValueT>
-void HashMap<KeyT, ValueT>::Iterator::_setNextBucket()
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+bool HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::_checkCapacity(bool addFlag) const
 {
-
-    while (_numOfBucket < _hashMap->capacity() and _hashMap->_hashSet[_numOfBucket].empty())
+    if (addFlag)
     {
-        _numOfBucket++;
+        return ((double) (_size + 1 + _table.tombstones()) / double(capacity())) > _upperLoadFactor;
     }
+    double loadFactor = ((double) (_size) / double(capacity()));
+    return loadFactor < _lowerLoadFactor;
 }
 
-template<class KeyT, class ValueT>
-void HashMap<KeyT, ValueT>::Iterator::_setNextPair()
+//Iterator Methods:
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+typename HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::Iterator & HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::Iterator::operator++()
 {
-    if (_pairNum == _hashMap->_hashSet[_numOfBucket].size())
+    _currentTable().advance(_position);
+    if (_inOldTable and _position == _hashMap->_oldTable.end())
     {
-        _numOfBucket++;
-        _pairNum = 0;
+        _inOldTable = false;
+        _position = _hashMap->_table.begin();
     }
+    return *this;
 }
 
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+bool HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::Iterator::operator!=(const HashMap::Iterator & other) const
+{
+    return !(*this == other);
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+bool HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::Iterator::operator==(const HashMap::Iterator & other) const
+{
+    return _hashMap == other._hashMap and _inOldTable == other._inOldTable and _position == other._position;
+}
+
+/**
+ * HashMap with open addressing and Robin Hood probing
+ */
+template<class KeyT, class ValueT, class Hash = KeyHash<KeyT>, class KeyEqual = std::equal_to<>,
+        class Allocator = std::allocator<std::pair<KeyT, ValueT>>>
+using RobinHoodHashMap = HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, RobinHoodStorage>;
+
+/**
+ * HashMap with open addressing and SIMD group probing
+ */
+template<class KeyT, class ValueT, class Hash = KeyHash<KeyT>, class KeyEqual = std::equal_to<>,
+        class Allocator = std::allocator<std::pair<KeyT, ValueT>>>
+using SwissHashMap = HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, SwissStorage>;
+
+/**
+ * HashMap that iterates its pairs in insertion order (until the first erase) by scanning a packed array
+ */
+template<class KeyT, class ValueT, class Hash = KeyHash<KeyT>, class KeyEqual = std::equal_to<>,
+        class Allocator = std::allocator<std::pair<KeyT, ValueT>>>
+using DenseHashMap = HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, DenseStorage>;
+
+template<class ValueT, class Storage = RobinHoodStorage>
+/**
+ * HashMap for maps that are built once and never erased from: the keys are views of bytes the caller copied
+ * with MonotonicArena::store, and the table itself is allocated from the same arena, so building the map
+ * costs one malloc per arena chunk and destroying it one free per chunk.
+ * Tables left behind by re-hashing stay in the arena until it is released, reserve first to avoid them.
+ * Construct it with the arena (which must outlive it): ArenaHashMap<int> map(arena);
+ */
+using ArenaHashMap = HashMap<std::string_view, ValueT, KeyHash<std::string_view>, std::equal_to<>,
+        ArenaAllocator<std::pair<std::string_view, ValueT>>, Storage>;
+
 #endif
 
@@ -0,0 +1,456 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include "HashMap.hpp"
+#include "FrozenHashMap.hpp"
+
+static const size_t KEYS_PER_LENGTH = 100000;
+
+static const int REPETITIONS = 5;
+
+static const uint64_t RANDOM_SEED = 20240601;
+
+static const uint64_t WY_SEED = 0x9e3779b97f4a7c15ull;
+
+static const char *const FIRST_LETTER = "a";
+
+static const int LETTERS = 26;
+
+static const char *const FROZEN_PATH = "HashMapBenchmark.frozen";
+
+static const size_t BATCH_TABLE_KEYS = 1 << 23;
+
+static const size_t BATCH_LOOKUPS = 1 << 22;
+
+static const size_t MERGE_KEYS = 10000000;
+
+static const size_t MERGE_KEY_LENGTH = 24;
+
+static const size_t MERGE_SHARED = 10;
+
+static const size_t MISS_TABLE_KEYS = 1 << 21;
+
+static const size_t MISS_LOOKUPS = 1 << 21;
+
+static const size_t MISS_KEY_LENGTH = 24;
+
+/**
+ * Inserts of new keys, each with an erase of the oldest key, made before the churned lookups of missing keys,
+ * as a multiple of the keys of the map
+ */
+static const size_t MISS_CHURN_ROUNDS = 3;
+
+static const char *const CHURN_PREFIX = "#";
+
+/**
+ * False positive rates of the negative filters measured, NO_FILTER first
+ */
+static const double FILTER_RATES[] = {NO_FILTER, 0.1, 0.01};
+
+/**
+ * Key lengths to measure: a single word, a short phrase, a sentence and a paragraph - the kinds of bad
+ * sequences a SpamDetector database holds
+ */
+static const size_t KEY_LENGTHS[] = {8, 24, 64, 200};
+
+/**
+ * Builds random lower case keys of the given length, words separated by spaces like SpamDetector phrases
+ * @param count - number of keys
+ * @param length - length of every key
+ * @param generator - random generator
+ * @return the keys
+ */
+std::vector<std::string> makeKeys(size_t count, size_t length, std::mt19937_64 & generator)
+{
+    std::uniform_int_distribution<int> letter(0, LETTERS);
+    std::vector<std::string> keys(count);
+    for (std::string & key : keys)
+    {
+        key.reserve(length);
+        for (size_t i = 0; i < length; i++)
+        {
+            int drawn = letter(generator);
+            key.push_back(drawn == LETTERS ? ' ' : static_cast<char>(FIRST_LETTER[0] + drawn));
+        }
+    }
+    return keys;
+}
+
+/**
+ * @return the best (shortest) time in nanoseconds per key of REPETITIONS runs of the given function
+ */
+template<class Function>
+double bestNanosPerKey(size_t keys, Function function)
+{
+    double best = 0;
+    for (int i = 0; i < REPETITIONS; i++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        function();
+        auto stop = std::chrono::steady_clock::now();
+        double nanos = std::chrono::duration<double, std::nano>(stop - start).count() / keys;
+        if (i == 0 or nanos < best)
+        {
+            best = nanos;
+        }
+    }
+    return best;
+}
+
+/**
+ * Measures hashing alone, and inserting and looking up all the keys in a HashMap using the given hash
+ * @param name - name of the hash function
+ * @param hash - the hash function
+ * @param keys - the keys to hash
+ */
+template<class Hash>
+void measure(const std::string & name, const Hash & hash, const std::vector<std::string> & keys)
+{
+    volatile size_t sink = 0;
+    double hashing = bestNanosPerKey(keys.size(), [&]()
+    {
+        size_t sum = 0;
+        for (const std::string & key : keys)
+        {
+            sum += hash(key);
+        }
+        sink = sink + sum;
+    });
+
+    double inserting = bestNanosPerKey(keys.size(), [&]()
+    {
+        RobinHoodHashMap<std::string, int, Hash> map(hash);
+        map.reserve(keys.size());
+        for (const std::string & key : keys)
+        {
+            map.try_emplace(key, 1);
+        }
+        sink = sink + map.size();
+    });
+
+    RobinHoodHashMap<std::string, int, Hash> map(hash);
+    for (const std::string & key : keys)
+    {
+        map.try_emplace(key, 1);
+    }
+    double finding = bestNanosPerKey(keys.size(), [&]()
+    {
+        size_t found = 0;
+        for (const std::string & key : keys)
+        {
+            found += map.containsKey(key);
+        }
+        sink = sink + found;
+    });
+
+    std::cout << std::setw(12) << name << std::setw(12) << hashing << std::setw(12) << inserting
+              << std::setw(12) << finding << "\n";
+}
+
+/**
+ * Measures building a map of all the keys once with std::string keys on the heap, and with the keys and the
+ * table in a MonotonicArena (ArenaHashMap), destruction included
+ * @param keys - the keys to insert
+ */
+void measureBuild(const std::vector<std::string> & keys)
+{
+    volatile size_t sink = 0;
+    double heap = bestNanosPerKey(keys.size(), [&]()
+    {
+        RobinHoodHashMap<std::string, int> map;
+        for (const std::string & key : keys)
+        {
+            map.try_emplace(key, 1);
+        }
+        sink = sink + map.size();
+    });
+
+    size_t arenaBytes = 0;
+    double arenaNanos = bestNanosPerKey(keys.size(), [&]()
+    {
+        MonotonicArena arena;
+        ArenaHashMap<int> map(arena);
+        for (const std::string & key : keys)
+        {
+            if (!map.containsKey(key))
+            {
+                map.insert(arena.store(key), 1);
+            }
+        }
+        sink = sink + map.size();
+        arenaBytes = arena.bytesReserved();
+    });
+
+    std::cout << std::setw(12) << "build" << std::setw(12) << "heap" << std::setw(12) << heap
+              << std::setw(12) << "arena" << std::setw(12) << arenaNanos << " (" << arenaBytes << " bytes)\n";
+}
+
+/**
+ * Measures the startup of a map frozen into a file, next to building it: opening the file (mapping it)
+ * and the first lookup of every key, which reads the pages in
+ * @param keys - the keys of the map
+ */
+void measureFrozen(const std::vector<std::string> & keys)
+{
+    RobinHoodHashMap<std::string, int> map;
+    for (const std::string & key : keys)
+    {
+        map.try_emplace(key, 1);
+    }
+    freeze(map, FROZEN_PATH);
+
+    auto start = std::chrono::steady_clock::now();
+    FrozenHashMap<int> frozen(FROZEN_PATH);
+    auto opened = std::chrono::steady_clock::now();
+    size_t found = 0;
+    for (const std::string & key : keys)
+    {
+        found += frozen.containsKey(key);
+    }
+    auto stop = std::chrono::steady_clock::now();
+    std::remove(FROZEN_PATH);
+
+    std::cout << std::setw(12) << "frozen" << std::setw(12) << "open (us)" << std::setw(12)
+              << std::chrono::duration<double, std::micro>(opened - start).count() << std::setw(12) << "find"
+              << std::setw(12) << std::chrono::duration<double, std::nano>(stop - opened).count() / keys.size()
+              << " (" << found << " found)\n";
+}
+
+/**
+ * Measures looking up random keys one by one (containsKey) and in batches (contains_batch) in a table larger
+ * than the last level cache, where every lookup is a cache miss, in nanoseconds per key
+ * @param name - name of the storage
+ * @param keys - the keys of the table
+ * @param lookups - the keys to look up
+ */
+template<class Storage>
+void measureBatch(const std::string & name, const std::vector<uint64_t> & keys, const std::vector<uint64_t> & lookups)
+{
+    HashMap<uint64_t, uint64_t, KeyHash<uint64_t>, std::equal_to<>, std::allocator<std::pair<uint64_t, uint64_t>>,
+            Storage> map;
+    map.reserve(keys.size());
+    for (uint64_t key : keys)
+    {
+        map.insert(key, key);
+    }
+
+    volatile size_t sink = 0;
+    double scalar = bestNanosPerKey(lookups.size(), [&]()
+    {
+        size_t found = 0;
+        for (uint64_t key : lookups)
+        {
+            found += map.containsKey(key);
+        }
+        sink = sink + found;
+    });
+
+    std::unique_ptr<bool[]> found(new bool[lookups.size()]);
+    double batched = bestNanosPerKey(lookups.size(), [&]()
+    {
+        map.contains_batch(lookups.data(), lookups.size(), found.get());
+        sink = sink + found[0];
+    });
+
+    std::cout << std::setw(12) << name << std::setw(12) << scalar << std::setw(12) << batched << "\n";
+}
+
+/**
+ * Measures looking up keys that are not in the map (containsKey), without a negative filter and with filters
+ * of the FILTER_RATES false positive rates, in nanoseconds per key, then again with the last filter after
+ * MISS_CHURN_ROUNDS times the keys have been inserted and as many erased, at a steady size and so without a
+ * re-hash (the filter must not fill up with the erased keys), and the bytes per key of the last filter
+ * @param name - name of the storage
+ * @param keys - the keys of the map
+ * @param missing - keys to look up, none of them in the map
+ */
+template<class Storage>
+void measureMisses(const std::string & name, const std::vector<std::string> & keys,
+                   const std::vector<std::string> & missing)
+{
+    HashMap<std::string, size_t, KeyHash<std::string>, std::equal_to<>,
+            std::allocator<std::pair<std::string, size_t>>, Storage> map;
+    map.reserve(keys.size());
+    for (size_t i = 0; i < keys.size(); i++)
+    {
+        map.insert(keys[i], i);
+    }
+
+    volatile size_t sink = 0;
+    auto lookUpMissing = [&]()
+    {
+        size_t found = 0;
+        for (const std::string & key : missing)
+        {
+            found += map.containsKey(key);
+        }
+        sink = sink + found;
+    };
+    std::cout << std::setw(12) << name;
+    for (double rate : FILTER_RATES)
+    {
+        map.setNegativeFilter(rate);
+        double nanos = bestNanosPerKey(missing.size(), lookUpMissing);
+        std::cout << std::setw(12) << nanos;
+    }
+
+    // every step adds a key none of the others can be equal to and erases the oldest one
+    size_t steps = MISS_CHURN_ROUNDS * keys.size();
+    for (size_t i = 0; i < steps; i++)
+    {
+        map.insert(CHURN_PREFIX + std::to_string(i), i);
+        map.erase(i < keys.size() ? keys[i] : CHURN_PREFIX + std::to_string(i - keys.size()));
+    }
+    double churned = bestNanosPerKey(missing.size(), lookUpMissing);
+    std::cout << std::setw(12) << churned;
+    std::cout << std::setw(12) << (double) (map.stats().filterBytes) / double(keys.size()) << "\n";
+}
+
+/**
+ * @return the given number spelled in lower case letters, padded to MERGE_KEY_LENGTH characters
+ */
+std::string mergeKey(size_t number)
+{
+    std::string key(MERGE_KEY_LENGTH, FIRST_LETTER[0]);
+    for (size_t i = 0; number != 0; i++, number /= LETTERS)
+    {
+        key[i] = static_cast<char>(FIRST_LETTER[0] + number % LETTERS);
+    }
+    return key;
+}
+
+/**
+ * Builds a map of MERGE_KEYS string keys, numbered from the given one
+ */
+template<class Map>
+void buildMergeMap(Map & map, size_t first)
+{
+    map.reserve(MERGE_KEYS);
+    for (size_t i = first; i < first + MERGE_KEYS; i++)
+    {
+        map.insert(mergeKey(i), i);
+    }
+}
+
+/**
+ * Moves the pairs of one map of MERGE_KEYS keys into another one (one key in MERGE_SHARED is in both, and
+ * stays behind): by copying every pair through insert and erasing it, and by merge, in nanoseconds per pair
+ * @param name - name of the storage
+ */
+template<class Storage>
+void measureMerge(const std::string & name)
+{
+    using Map = HashMap<std::string, size_t, KeyHash<std::string>, std::equal_to<>,
+            std::allocator<std::pair<std::string, size_t>>, Storage>;
+    size_t sourceFirst = MERGE_KEYS - MERGE_KEYS / MERGE_SHARED;
+    double copied;
+    size_t left;
+    {
+        Map target, source;
+        buildMergeMap(target, 0);
+        buildMergeMap(source, sourceFirst);
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::string> moved;
+        for (const auto & pair : source)
+        {
+            if (target.insert(pair.first, pair.second))
+            {
+                moved.push_back(pair.first);
+            }
+        }
+        for (const std::string & key : moved)
+        {
+            source.erase(key);
+        }
+        copied = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        left = source.size();
+    }
+
+    double merged;
+    {
+        Map target, source;
+        buildMergeMap(target, 0);
+        buildMergeMap(source, sourceFirst);
+        auto start = std::chrono::steady_clock::now();
+        target.merge(source);
+        merged = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        if (source.size() != left)
+        {
+            std::cerr << "merge left " << source.size() << " pairs instead of " << left << "\n";
+        }
+    }
+
+    std::cout << std::setw(12) << name << std::setw(12) << copied / MERGE_KEYS << std::setw(12)
+              << merged / MERGE_KEYS << "\n";
+}
+
+/**
+ * Compares the hash functions of KeyHash.hpp on string keys of the lengths SpamDetector sees, and building
+ * a map on the heap with building it in an arena and with opening it frozen, lookups one by one and in
+ * batches, lookups of missing keys with and without a negative filter, and moving the pairs of one map into
+ * another with merge, in nanoseconds per key (lower is better)
+ */
+int main()
+{
+    std::mt19937_64 generator(RANDOM_SEED);
+    std::cout << std::fixed << std::setprecision(1);
+    for (size_t length : KEY_LENGTHS)
+    {
+        std::vector<std::string> keys = makeKeys(KEYS_PER_LENGTH, length, generator);
+        std::cout << "key length " << length << ", " << keys.size() << " keys (ns per key)\n";
+        std::cout << std::setw(12) << "hash" << std::setw(12) << "hashing" << std::setw(12) << "insert"
+                  << std::setw(12) << "find" << "\n";
+        measure("KeyHash", KeyHash<std::string>(), keys);
+        measure("WyHash", WyHash(), keys);
+        measure("WyHash+seed", WyHash(WY_SEED), keys);
+        measure("FnvHash", FnvHash(), keys);
+        measureBuild(keys);
+        measureFrozen(keys);
+        std::cout << "\n";
+    }
+
+    std::vector<uint64_t> tableKeys(BATCH_TABLE_KEYS), lookups(BATCH_LOOKUPS);
+    for (uint64_t & key : tableKeys)
+    {
+        key = generator();
+    }
+    std::uniform_int_distribution<size_t> pick(0, BATCH_TABLE_KEYS - 1);
+    for (uint64_t & key : lookups)
+    {
+        key = tableKeys[pick(generator)];
+    }
+    std::cout << BATCH_TABLE_KEYS << " integer keys, random lookups (ns per key)\n";
+    std::cout << std::setw(12) << "storage" << std::setw(12) << "find" << std::setw(12) << "batch" << "\n";
+    measureBatch<ChainedStorage>("chained", tableKeys, lookups);
+    measureBatch<RobinHoodStorage>("robin hood", tableKeys, lookups);
+    measureBatch<SwissStorage>("swiss", tableKeys, lookups);
+    std::cout << "\n";
+
+    std::vector<std::string> present = makeKeys(MISS_TABLE_KEYS, MISS_KEY_LENGTH, generator);
+    std::vector<std::string> missing = makeKeys(MISS_LOOKUPS, MISS_KEY_LENGTH + 1, generator);
+    std::cout << MISS_TABLE_KEYS << " string keys, lookups of missing keys (ns per key)\n";
+    std::cout << std::setw(12) << "storage" << std::setw(12) << "no filter";
+    for (size_t i = 1; i < sizeof(FILTER_RATES) / sizeof(FILTER_RATES[0]); i++)
+    {
+        std::cout << std::setw(11) << FILTER_RATES[i] * 100 << "%";
+    }
+    std::cout << std::setw(12) << "churned" << std::setw(12) << "bytes/key" << "\n";
+    measureMisses<ChainedStorage>("chained", present, missing);
+    measureMisses<RobinHoodStorage>("robin hood", present, missing);
+    measureMisses<SwissStorage>("swiss", present, missing);
+    measureMisses<DenseStorage>("dense", present, missing);
+    std::cout << "\n";
+
+    std::cout << "merging two maps of " << MERGE_KEYS << " string keys (ns per pair)\n";
+    std::cout << std::setw(12) << "storage" << std::setw(12) << "copy+erase" << std::setw(12) << "merge" << "\n";
+    measureMerge<ChainedStorage>("chained");
+    measureMerge<RobinHoodStorage>("robin hood");
+    measureMerge<SwissStorage>("swiss");
+    measureMerge<DenseStorage>("dense");
+    return 0;
+}
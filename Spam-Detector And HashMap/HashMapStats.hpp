@@ -0,0 +1,234 @@
+#include <atomic>
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+
+
+#ifndef CPP_EX3_HASHMAPSTATS_HPP
+#define CPP_EX3_HASHMAPSTATS_HPP
+
+/**
+ * Hits and misses of the operations of a HashMap. Counted only when compiled with HASHMAP_COUNTERS defined
+ * (every operation then pays for a relaxed atomic increment), all zero otherwise.
+ */
+struct OperationCounts
+{
+    /**
+     * find, containsKey, at and the batched lookups that found the key, and those that did not
+     */
+    size_t lookupHits = 0;
+
+    size_t lookupMisses = 0;
+
+    /**
+     * insert, emplace, try_emplace, insert_or_assign and operator[] that added a pair, and those that
+     * found the key already there
+     */
+    size_t inserts = 0;
+
+    size_t insertHits = 0;
+
+    /**
+     * erase that removed a pair, and erase of a key that was not there
+     */
+    size_t erases = 0;
+
+    size_t eraseMisses = 0;
+};
+
+/**
+ * The live counters behind OperationCounts. Lookups are const and may run on many threads at once
+ * (ConcurrentHashMap readers share a lock), so the counters are atomics, incremented relaxed.
+ */
+class OperationCounters
+{
+public:
+
+    enum Operation
+    {
+        LOOKUP, INSERT, ERASE, OPERATIONS
+    };
+
+    OperationCounters() = default;
+
+    OperationCounters(const OperationCounters & other) = delete;
+
+    OperationCounters & operator=(const OperationCounters & other) = delete;
+
+    /**
+     * Counts one operation
+     * @param operation - the kind of operation
+     * @param hit - true if the operation found its key
+     */
+    void count(Operation operation, bool hit) const
+    {
+        _counts[operation][hit ? HIT : MISS].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /**
+     * @return the counts so far
+     */
+    OperationCounts snapshot() const
+    {
+        OperationCounts counts;
+        counts.lookupHits = _load(LOOKUP, HIT);
+        counts.lookupMisses = _load(LOOKUP, MISS);
+        counts.inserts = _load(INSERT, MISS);
+        counts.insertHits = _load(INSERT, HIT);
+        counts.erases = _load(ERASE, HIT);
+        counts.eraseMisses = _load(ERASE, MISS);
+        return counts;
+    }
+
+    /**
+     * This exchanges the counts of two counters, which no other thread may be using
+     */
+    void swap(OperationCounters & other)
+    {
+        for (int operation = 0; operation < OPERATIONS; operation++)
+        {
+            for (int outcome = 0; outcome < OUTCOMES; outcome++)
+            {
+                size_t mine = _counts[operation][outcome].load(std::memory_order_relaxed);
+                _counts[operation][outcome].store(other._counts[operation][outcome].load(std::memory_order_relaxed),
+                                                  std::memory_order_relaxed);
+                other._counts[operation][outcome].store(mine, std::memory_order_relaxed);
+            }
+        }
+    }
+
+private:
+
+    enum Outcome
+    {
+        MISS, HIT, OUTCOMES
+    };
+
+    mutable std::atomic<size_t> _counts[OPERATIONS][OUTCOMES] = {};
+
+    size_t _load(Operation operation, Outcome outcome) const
+    {
+        return _counts[operation][outcome].load(std::memory_order_relaxed);
+    }
+};
+
+/**
+ * A picture of the memory and of the hash distribution of a HashMap, see HashMap::stats
+ */
+struct HashMapStats
+{
+    size_t size = 0;
+
+    size_t capacity = 0;
+
+    double loadFactor = 0;
+
+    /**
+     * slots left behind by erase (open addressing storages)
+     */
+    size_t tombstones = 0;
+
+    /**
+     * bytes allocated by the table: its buckets or slots, control bytes, and pairs stored out of line
+     * (and the old table while an incremental re-hash is in progress, and the table prepared for the next
+     * growth once all its slots are ready)
+     */
+    size_t tableBytes = 0;
+
+    /**
+     * bytes of the negative filter, 0 without one (see HashMap::setNegativeFilter)
+     */
+    size_t filterBytes = 0;
+
+    /**
+     * bytes the keys allocated themselves, for the key types that tell (see heapBytes)
+     */
+    size_t keyHeapBytes = 0;
+
+    /**
+     * probeLengths[i] is the number of pairs a lookup finds at its (i+1)th probe: the (i+1)th pair of its
+     * bucket for ChainedStorage, i slots from its home for RobinHoodStorage, i groups from its home group
+     * for SwissStorage. A good hash function keeps it short and steep.
+     */
+    std::vector<size_t> probeLengths;
+
+    /**
+     * the longest probe (the longest chain for ChainedStorage)
+     */
+    size_t maxProbeLength = 0;
+
+    double meanProbeLength = 0;
+
+    /**
+     * number of re-hashes and the time they took, an incremental re-hash counted once but timed with every step
+     */
+    size_t rehashes = 0;
+
+    double rehashSeconds = 0;
+
+    OperationCounts operations;
+};
+
+/**
+ * Writes the statistics as one line of name=value fields, the probe lengths as a comma separated list,
+ * meant for logs and metric exporters
+ */
+inline std::ostream & operator<<(std::ostream & out, const HashMapStats & stats)
+{
+    out << "size=" << stats.size << " capacity=" << stats.capacity << " load_factor=" << stats.loadFactor
+        << " tombstones=" << stats.tombstones << " table_bytes=" << stats.tableBytes << " filter_bytes="
+        << stats.filterBytes << " key_heap_bytes="
+        << stats.keyHeapBytes << " max_probe_length=" << stats.maxProbeLength << " mean_probe_length="
+        << stats.meanProbeLength << " rehashes=" << stats.rehashes << " rehash_seconds=" << stats.rehashSeconds
+        << " lookup_hits=" << stats.operations.lookupHits << " lookup_misses=" << stats.operations.lookupMisses
+        << " inserts=" << stats.operations.inserts << " insert_hits=" << stats.operations.insertHits
+        << " erases=" << stats.operations.erases << " erase_misses=" << stats.operations.eraseMisses
+        << " probe_lengths=";
+    for (size_t i = 0; i < stats.probeLengths.size(); i++)
+    {
+        out << (i == 0 ? "" : ",") << stats.probeLengths[i];
+    }
+    return out;
+}
+
+/**
+ * Counts a pair found at the given probe in a probe length histogram (see HashMapStats::probeLengths)
+ * @param histogram - the histogram, grown as needed
+ * @param length - the probe the pair is found at, from 1
+ */
+inline void countProbeLength(std::vector<size_t> & histogram, size_t length)
+{
+    if (histogram.size() < length)
+    {
+        histogram.resize(length, 0);
+    }
+    histogram[length - 1]++;
+}
+
+template<class T>
+/**
+ * @return the bytes a value allocated on its own, 0 for types that do not tell
+ */
+size_t heapBytes(const T &)
+{
+    return 0;
+}
+
+template<class CharT, class Traits, class Alloc>
+/**
+ * @return the bytes of the string's buffer when it is on the heap, 0 when the string is short enough to be
+ * stored inside the string object
+ */
+size_t heapBytes(const std::basic_string<CharT, Traits, Alloc> & string)
+{
+    const char *data = reinterpret_cast<const char *>(string.data());
+    const char *object = reinterpret_cast<const char *>(&string);
+    if (data >= object and data < object + sizeof(string))
+    {
+        return 0;
+    }
+    return (string.capacity() + 1) * sizeof(CharT);
+}
+
+#endif
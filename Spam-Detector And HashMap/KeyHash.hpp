@@ -0,0 +1,311 @@
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+
+#ifndef CPP_EX3_KEYHASH_HPP
+#define CPP_EX3_KEYHASH_HPP
+
+static const uint64_t WY_SECRET[4] = {0x2d358dccaa6c78a5ull, 0x8bb84b93962eacc9ull,
+                                      0x4b33a62ed433d4a3ull, 0x4d5a2da51de1aa47ull};
+
+static const uint64_t FNV_OFFSET_BASIS = 0xcbf29ce484222325ull;
+
+static const uint64_t FNV_PRIME = 0x100000001b3ull;
+
+static const uint64_t HASH_MIX_MULTIPLIER = 0x9e3779b97f4a7c15ull;
+
+static const unsigned int HASH_MIX_SHIFT = 32;
+
+static const size_t END_BUCKET = SIZE_MAX;
+
+/**
+ * Passed to the constructor of a table to allocate its slots without touching them: the owner then makes them
+ * empty a range at a time with initializeSlots, before the table is used
+ */
+static const bool DEFER_SLOTS = true;
+
+template<class KeyT>
+/**
+ * Chooses at compile time whether the tables keep the full hash code of every key next to its pair.
+ * A kept hash code is compared before the keys on every probe and reused when re-hashing, which pays off
+ * for keys that are slow to hash or to compare (strings); numbers, enums and pointers hash to (almost) the
+ * identity, so for them nothing is kept and nothing is paid. Specialize it to choose otherwise for a key type.
+ * @tparam KeyT - represents a key for the map
+ */
+struct CacheHashCode : std::integral_constant<bool, !(std::is_arithmetic<KeyT>::value or std::is_enum<KeyT>::value or
+                                                      std::is_pointer<KeyT>::value)>
+{
+};
+
+/**
+ * Spreads every bit of a hash code over the whole word, so that the low bits the tables index by depend on
+ * the high bits too: std::hash of an integer is the integer itself, and keys that differ only in their high
+ * bits (or are all multiples of a power of two) would otherwise share buckets. The tables apply it to the
+ * result of the hash function, the hash code they store and compare is the mixed one.
+ * @param hash - hash code returned by a hash function
+ * @return the mixed hash code
+ */
+inline size_t mixHash(size_t hash)
+{
+    uint64_t mixed = static_cast<uint64_t>(hash);
+    mixed ^= mixed >> HASH_MIX_SHIFT;
+    mixed *= HASH_MIX_MULTIPLIER;
+    mixed ^= mixed >> HASH_MIX_SHIFT;
+    return static_cast<size_t>(mixed);
+}
+
+template<bool Cached>
+/**
+ * The hash code a table keeps with each of its pairs, a base of the tables' slots (see CacheHashCode)
+ */
+struct StoredHash
+{
+    size_t hash;
+
+    void storeHash(size_t code)
+    {
+        hash = code;
+    }
+
+    void copyHash(const StoredHash & other)
+    {
+        hash = other.hash;
+    }
+
+    void swapHash(size_t & code)
+    {
+        std::swap(hash, code);
+    }
+
+    /**
+     * @return false only if the pair's key certainly has another hash code, so it need not be compared
+     */
+    bool hashMatches(size_t code) const
+    {
+        return hash == code;
+    }
+
+    /**
+     * @return the hash code of the pair's key
+     */
+    template<class Hash, class K>
+    size_t storedHash(const Hash &, const K &) const
+    {
+        return hash;
+    }
+};
+
+template<>
+/**
+ * Nothing is kept: every probe compares the keys and re-hashing hashes every key again.
+ * Being empty, it takes no room in the slots that derive from it.
+ */
+struct StoredHash<false>
+{
+    void storeHash(size_t)
+    {}
+
+    void copyHash(const StoredHash &)
+    {}
+
+    void swapHash(size_t &)
+    {}
+
+    bool hashMatches(size_t) const
+    {
+        return true;
+    }
+
+    template<class Hash, class K>
+    size_t storedHash(const Hash & hash, const K & key) const
+    {
+        return mixHash(hash(key));
+    }
+};
+
+/**
+ * Asks the CPU to start loading the cache line of the given address, without waiting for it (a no-op on
+ * compilers without the builtin). Used by the tables to overlap the cache misses of batched lookups.
+ */
+inline void prefetchAddress(const void *address)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_prefetch(address);
+#else
+    (void) address;
+#endif
+}
+
+template<class KeyT>
+/**
+ * The hash function HashMap uses by default: std::hash of the key type.
+ * @tparam KeyT - represents a key for the map
+ */
+struct KeyHash : std::hash<KeyT>
+{
+};
+
+template<>
+/**
+ * String keys are hashed through std::string_view, which gives the same hash code as std::hash<std::string>
+ * but also accepts a std::string_view or a const char* directly, without building a temporary string.
+ * Being transparent, it lets HashMap look up string keys by any of these types.
+ */
+struct KeyHash<std::string>
+{
+    using is_transparent = void;
+
+    size_t operator()(std::string_view key) const
+    {
+        return std::hash<std::string_view>{}(key);
+    }
+};
+
+/**
+ * A fast non-cryptographic string hash in the style of wyhash: the bytes are read 8 (or 4) at a time and
+ * folded with 64x64->128 bit multiplications. Transparent, like KeyHash<std::string>.
+ * Seeding it gives every map its own hash codes, so keys crafted to collide in one map do not collide in
+ * another one.
+ */
+class WyHash
+{
+public:
+
+    using is_transparent = void;
+
+    /**
+     * Constructor
+     * @param seed - the seed of the hash function
+     */
+    explicit WyHash(uint64_t seed = 0) : _seed(seed)
+    {}
+
+    size_t operator()(std::string_view key) const
+    {
+        const unsigned char *p = reinterpret_cast<const unsigned char *>(key.data());
+        size_t length = key.size();
+        uint64_t seed = _seed ^ _mix(_seed ^ WY_SECRET[0], WY_SECRET[1]);
+        uint64_t a, b;
+
+        if (length <= 16)
+        {
+            if (length >= 4)
+            {
+                a = (_read4(p) << 32) | _read4(p + ((length >> 3) << 2));
+                b = (_read4(p + length - 4) << 32) | _read4(p + length - 4 - ((length >> 3) << 2));
+            }
+            else if (length > 0)
+            {
+                a = (uint64_t(p[0]) << 16) | (uint64_t(p[length >> 1]) << 8) | p[length - 1];
+                b = 0;
+            }
+            else
+            {
+                a = b = 0;
+            }
+        }
+        else
+        {
+            size_t left = length;
+            if (left > 48)
+            {
+                uint64_t see1 = seed, see2 = seed;
+                do
+                {
+                    seed = _mix(_read8(p) ^ WY_SECRET[1], _read8(p + 8) ^ seed);
+                    see1 = _mix(_read8(p + 16) ^ WY_SECRET[2], _read8(p + 24) ^ see1);
+                    see2 = _mix(_read8(p + 32) ^ WY_SECRET[3], _read8(p + 40) ^ see2);
+                    p += 48;
+                    left -= 48;
+                } while (left > 48);
+                seed ^= see1 ^ see2;
+            }
+            while (left > 16)
+            {
+                seed = _mix(_read8(p) ^ WY_SECRET[1], _read8(p + 8) ^ seed);
+                left -= 16;
+                p += 16;
+            }
+            a = _read8(p + left - 16);
+            b = _read8(p + left - 8);
+        }
+        a ^= WY_SECRET[1];
+        b ^= seed;
+        _multiply(a, b);
+        return static_cast<size_t>(_mix(a ^ WY_SECRET[0] ^ length, b ^ WY_SECRET[1]));
+    }
+
+private:
+
+    uint64_t _seed;
+
+    /**
+     * Replaces a and b with the low and high halves of their 128 bit product
+     */
+    static void _multiply(uint64_t & a, uint64_t & b)
+    {
+#ifdef __SIZEOF_INT128__
+        __uint128_t product = static_cast<__uint128_t>(a) * b;
+        a = static_cast<uint64_t>(product);
+        b = static_cast<uint64_t>(product >> 64);
+#else
+        uint64_t aHigh = a >> 32, aLow = static_cast<uint32_t>(a);
+        uint64_t bHigh = b >> 32, bLow = static_cast<uint32_t>(b);
+        uint64_t high = aHigh * bHigh, middle0 = aHigh * bLow, middle1 = aLow * bHigh, low = aLow * bLow;
+        uint64_t carry = (static_cast<uint32_t>(middle0) + static_cast<uint64_t>(static_cast<uint32_t>(middle1)) +
+                          (low >> 32)) >> 32;
+        a = low + (middle0 << 32) + (middle1 << 32);
+        b = high + (middle0 >> 32) + (middle1 >> 32) + carry;
+#endif
+    }
+
+    /**
+     * @return the xor of the halves of the 128 bit product of a and b
+     */
+    static uint64_t _mix(uint64_t a, uint64_t b)
+    {
+        _multiply(a, b);
+        return a ^ b;
+    }
+
+    static uint64_t _read8(const unsigned char *p)
+    {
+        uint64_t value;
+        std::memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    static uint64_t _read4(const unsigned char *p)
+    {
+        uint32_t value;
+        std::memcpy(&value, p, sizeof(value));
+        return value;
+    }
+};
+
+/**
+ * 64 bit FNV-1a string hash: one xor and one multiplication per byte. Simple and well spread for short keys,
+ * slow for long ones. Transparent, like KeyHash<std::string>.
+ */
+struct FnvHash
+{
+    using is_transparent = void;
+
+    size_t operator()(std::string_view key) const
+    {
+        uint64_t hash = FNV_OFFSET_BASIS;
+        for (unsigned char c : key)
+        {
+            hash = (hash ^ c) * FNV_PRIME;
+        }
+        return static_cast<size_t>(hash);
+    }
+};
+
+#endif
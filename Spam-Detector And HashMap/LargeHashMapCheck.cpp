@@ -0,0 +1,128 @@
+#include <iostream>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include "HashMap.hpp"
+
+static const char *const LARGE_FLAG = "--large";
+
+static const char *const LARGE_VARIABLE = "HASHMAP_LARGE_TEST";
+
+static const size_t SLOTS_LIMIT = size_t(1) << 31;
+
+/**
+ * Pairs reserved for, so the table gets more than SLOTS_LIMIT slots and keeps them while keys are erased
+ */
+static const size_t RESERVED = SLOTS_LIMIT;
+
+static const size_t KEYS = size_t(1) << 24;
+
+/**
+ * Bits of the hash code below the ones the keys differ in: every key hashes to a multiple of 2^32
+ */
+static const int HIGH_SHIFT = 32;
+
+/**
+ * Hashes a key into the high half of the hash code only, so the keys differ in no bit an int (or any
+ * truncation to 32 bits) would keep
+ */
+struct HighBitsHash
+{
+    size_t operator()(uint64_t key) const
+    {
+        return static_cast<size_t>(key) << HIGH_SHIFT;
+    }
+};
+
+typedef HashMap<uint64_t, uint32_t, HighBitsHash, std::equal_to<uint64_t>,
+                std::allocator<std::pair<uint64_t, uint32_t>>, RobinHoodStorage> LargeMap;
+
+/**
+ * Prints the given failure to cerr
+ * @return EXIT_FAILURE
+ */
+int fail(const char *message)
+{
+    std::cerr << "LargeHashMapCheck: " << message << "\n";
+    return EXIT_FAILURE;
+}
+
+/**
+ * Builds a RobinHoodStorage HashMap with more than 2^31 slots (about 100GB of memory) and checks that
+ * it works past the 32 bit limit: KEYS keys whose hash codes differ only in their high 32 bits are inserted,
+ * found again with their values, spread to bucket indices above 2^31, and erased, with size() following.
+ * Runs only when given --large or when HASHMAP_LARGE_TEST is set, as most machines cannot hold the table.
+ */
+int main(int argc, char *argv[])
+{
+    bool large = std::getenv(LARGE_VARIABLE) != nullptr;
+    for (int i = 1; i < argc; i++)
+    {
+        large = large or std::strcmp(argv[i], LARGE_FLAG) == 0;
+    }
+    if (!large)
+    {
+        std::cout << "LargeHashMapCheck: skipped, needs about 100GB of memory (run with " << LARGE_FLAG
+                  << " or set " << LARGE_VARIABLE << ")\n";
+        return EXIT_SUCCESS;
+    }
+
+    LargeMap map;
+    map.reserve(RESERVED);
+    if (map.capacity() <= SLOTS_LIMIT)
+    {
+        return fail("the table has no more than 2^31 slots");
+    }
+    size_t capacity = map.capacity();
+    bool highIndex = false;
+    for (uint64_t key = 0; key < KEYS; key++)
+    {
+        if (!map.insert(key, static_cast<uint32_t>(key)))
+        {
+            return fail("a new key was taken for one already in the map");
+        }
+        highIndex = highIndex or map.getKeyIndex(key) >= SLOTS_LIMIT;
+    }
+    if (map.size() != KEYS or map.capacity() != capacity)
+    {
+        return fail("size() or capacity() is wrong after the inserts");
+    }
+    if (!highIndex)
+    {
+        return fail("no key went to a bucket index above 2^31");
+    }
+    for (uint64_t key = 0; key < KEYS; key++)
+    {
+        auto found = map.find(key);
+        if (found == map.end() or found->second != static_cast<uint32_t>(key))
+        {
+            return fail("an inserted key was not found with its value");
+        }
+        if (map.containsKey(key + KEYS))
+        {
+            return fail("a key never inserted was found");
+        }
+    }
+    for (uint64_t key = 0; key < KEYS; key += 2)
+    {
+        if (!map.erase(key))
+        {
+            return fail("an inserted key could not be erased");
+        }
+    }
+    if (map.size() != KEYS / 2 or map.capacity() != capacity)
+    {
+        return fail("size() or capacity() is wrong after the erases");
+    }
+    for (uint64_t key = 0; key < KEYS; key++)
+    {
+        if (map.containsKey(key) != (key % 2 == 1))
+        {
+            return fail("an erase removed the wrong key");
+        }
+    }
+    std::cout << "LargeHashMapCheck: " << capacity << " slots, " << KEYS << " keys differing only in their high "
+              << "hash bits, all found\n";
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,613 @@
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#include "HashMap.hpp"
+#include "ConcurrentHashMap.hpp"
+
+
+#ifndef CPP_EX3_LRUCACHE_HPP
+#define CPP_EX3_LRUCACHE_HPP
+
+static const size_t NO_NODE = SIZE_MAX;
+
+static const char *const CACHE_CAPACITY_ERR = "Capacity of a cache must be positive";
+
+/**
+ * How a full cache picks the pair to evict
+ */
+enum EvictionPolicy
+{
+    /**
+     * the least recently used pair: every hit moves its pair to the front of the recency list
+     */
+    LRU_EVICTION,
+
+    /**
+     * CLOCK, an approximation of LRU: a hit only sets the reference bit of its pair, and a hand sweeping the
+     * pairs in a circle evicts the first one whose bit is clear (clearing the bits it passes). Hits write one
+     * byte instead of relinking two list nodes.
+     */
+    CLOCK_EVICTION
+};
+
+/**
+ * Hits, misses and evictions of a cache since it was built
+ */
+struct CacheStats
+{
+    size_t hits = 0;
+
+    size_t misses = 0;
+
+    size_t evictions = 0;
+
+    /**
+     * @return the fraction of lookups that hit, 0 before the first lookup
+     */
+    double hitRatio() const
+    {
+        return hits + misses == 0 ? 0 : (double) (hits) / double(hits + misses);
+    }
+};
+
+template<class KeyT, class ValueT, class Hash = KeyHash<KeyT>, class KeyEqual = std::equal_to<>>
+/**
+ * A cache of at most capacity (key,value) pairs: when a new key is put into a full cache, the pair chosen by
+ * the eviction policy makes room for it.
+ * The pairs live in an array of nodes allocated once for the capacity, a HashMap maps every key to its node,
+ * and the nodes are linked (by index) into an intrusive recency list, so get, put and eviction take O(1) and
+ * never allocate once the cache is full. The map is reserved for the capacity and never re-hashes.
+ * @tparam KeyT - represents a key for the cache
+ * @tparam ValueT - represents a value for the cache
+ * @tparam Hash - hash function of the keys
+ * @tparam KeyEqual - equality of the keys
+ */
+class LruCache
+{
+public:
+
+    /**
+     * Constructor
+     * @param capacity - the most pairs the cache holds, must be positive
+     * @param policy - how a full cache picks the pair to evict
+     * @param hash - hash function of the keys
+     * @param equal - equality of the keys
+     */
+    explicit LruCache(size_t capacity, EvictionPolicy policy = LRU_EVICTION, const Hash & hash = Hash(),
+                      const KeyEqual & equal = KeyEqual());
+
+    /**
+     * Copies the value of the key out of the cache, a hit makes the pair the most recently used
+     * @param key - key value
+     * @param value - set to the value of the key if it is in the cache
+     * @return true if the key is in the cache (a hit)
+     */
+    bool get(const KeyT & key, ValueT & value);
+
+    /**
+     * Maps the key to the given value, a new key evicts a pair when the cache is full
+     * @param key - key value
+     * @param value - the value of the key
+     * @return true if the key has been added and false if its value has been replaced
+     */
+    bool put(const KeyT & key, const ValueT & value);
+
+    /**
+     * @return True if the given key is in the cache, without counting a lookup or touching its recency
+     */
+    bool containsKey(const KeyT & key) const;
+
+    /**
+     * Removes the pair of the key
+     * @param key - key value
+     * @return true if the pair has been removed and false otherwise
+     */
+    bool erase(const KeyT & key);
+
+    /**
+     * Removes all the pairs, keeping the counters
+     */
+    void clear();
+
+    /**
+     * @return number of pairs in the cache
+     */
+    size_t size() const;
+
+    /**
+     * @return the most pairs the cache holds
+     */
+    size_t capacity() const;
+
+    /**
+     * @return the eviction policy of the cache
+     */
+    EvictionPolicy policy() const;
+
+    /**
+     * @return hits, misses and evictions so far
+     */
+    CacheStats stats() const;
+
+private:
+
+    /**
+     * A pair of the cache and its links in the recency list (from the most recently used to the least),
+     * or in the list of free nodes; in CLOCK mode only the reference bit orders the pairs
+     */
+    struct Node
+    {
+        KeyT key;
+
+        ValueT value;
+
+        size_t previous;
+
+        size_t next;
+
+        bool referenced;
+
+        bool used;
+    };
+
+    HashMap<KeyT, size_t, Hash, KeyEqual> _index;
+
+    std::vector<Node> _nodes;
+
+    size_t _capacity;
+
+    EvictionPolicy _policy;
+
+    size_t _head;
+
+    size_t _tail;
+
+    size_t _free;
+
+    size_t _hand;
+
+    CacheStats _stats;
+
+    /**
+     * Makes the given node the most recently used one
+     */
+    void _touch(size_t node);
+
+    /**
+     * Links the given node at the front of the recency list
+     */
+    void _pushFront(size_t node);
+
+    /**
+     * Unlinks the given node from the recency list
+     */
+    void _unlink(size_t node);
+
+    /**
+     * Evicts a pair chosen by the policy
+     * @return the node of the evicted pair, now free
+     */
+    size_t _evict();
+
+    /**
+     * @return a node to hold a new pair: a free one, a new one while the cache is not full, or an evicted one
+     */
+    size_t _acquire();
+
+    /**
+     * Removes the pair of the given node from the cache and frees the node
+     */
+    void _release(size_t node);
+};
+
+template<class KeyT, class ValueT, class Hash = KeyHash<KeyT>, class KeyEqual = std::equal_to<>>
+/**
+ * An LruCache that can be shared between threads: the keys are split by their hash code between independent
+ * shards (as in ConcurrentHashMap), each a cache of its share of the capacity guarded by its own lock.
+ * A get changes the recency of its pair, so every operation locks its shard exclusively; CLOCK mode keeps the
+ * time a hit holds the lock short. Eviction is per shard, so the pair evicted is the least recently used of its
+ * shard rather than of the whole cache.
+ * @tparam KeyT - represents a key for the cache
+ * @tparam ValueT - represents a value for the cache
+ * @tparam Hash - hash function of the keys
+ * @tparam KeyEqual - equality of the keys
+ */
+class ShardedLruCache
+{
+    using shardCache = LruCache<KeyT, ValueT, Hash, KeyEqual>;
+
+    /**
+     * One shard: a cache and its lock, on a cache line of their own
+     */
+    struct alignas(CACHE_LINE) Shard
+    {
+        mutable std::mutex mutex;
+
+        shardCache cache;
+
+        Shard(size_t capacity, EvictionPolicy policy, const Hash & hash, const KeyEqual & equal) :
+                cache(capacity, policy, hash, equal)
+        {}
+    };
+
+public:
+
+    /**
+     * Constructor
+     * @param capacity - the most pairs the cache holds, split evenly between the shards (rounded up)
+     * @param policy - how a full shard picks the pair to evict
+     * @param shards - number of shards, rounded up to a power of two
+     * @param hash - hash function of the keys
+     * @param equal - equality of the keys
+     */
+    explicit ShardedLruCache(size_t capacity, EvictionPolicy policy = LRU_EVICTION, size_t shards = DEFAULT_SHARDS,
+                             const Hash & hash = Hash(), const KeyEqual & equal = KeyEqual());
+
+    ShardedLruCache(const ShardedLruCache & other) = delete;
+
+    ShardedLruCache & operator=(const ShardedLruCache & other) = delete;
+
+    /**
+     * Copies the value of the key out of the cache (see LruCache::get)
+     */
+    bool get(const KeyT & key, ValueT & value);
+
+    /**
+     * Maps the key to the given value (see LruCache::put)
+     */
+    bool put(const KeyT & key, const ValueT & value);
+
+    /**
+     * @return True if the given key is in the cache
+     */
+    bool containsKey(const KeyT & key) const;
+
+    /**
+     * Removes the pair of the key
+     * @return true if the pair has been removed and false otherwise
+     */
+    bool erase(const KeyT & key);
+
+    /**
+     * Removes all the pairs
+     */
+    void clear();
+
+    /**
+     * @return number of pairs in the cache, the shards counted one after the other
+     */
+    size_t size() const;
+
+    /**
+     * @return the most pairs the cache holds
+     */
+    size_t capacity() const;
+
+    /**
+     * @return hits, misses and evictions of all the shards
+     */
+    CacheStats stats() const;
+
+private:
+
+    std::deque<Shard> _shards;
+
+    size_t _shardCount;
+
+    Hash _hash;
+
+    /**
+     * @return the shard of the key, picked by the high bits of its mixed hash code (see ConcurrentHashMap)
+     */
+    Shard & _shardOf(const KeyT & key) const;
+};
+
+//=================LruCache implementation==================//
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual>
+LruCache<KeyT, ValueT, Hash, KeyEqual>::LruCache(size_t capacity, EvictionPolicy policy, const Hash & hash,
+                                                 const KeyEqual & equal) :
+        _index(hash, equal), _capacity(capacity), _policy(policy), _head(NO_NODE), _tail(NO_NODE), _free(NO_NODE),
+        _hand(0)
+{
+    if (capacity == 0)
+    {
+        throw (std::invalid_argument(CACHE_CAPACITY_ERR));
+    }
+    _index.reserve(capacity);
+    _nodes.reserve(capacity);
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual>
+bool LruCache<KeyT, ValueT, Hash, KeyEqual>::get(const KeyT & key, ValueT & value)
+{
+    auto found = _index.find(key);
+    if (found == _index.end())
+    {
+        _stats.misses++;
+        return false;
+    }
+    _stats.hits++;
+    _touch(found->second);
+    value = _nodes[found->second].value;
+    return true;
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual>
+bool LruCache<KeyT, ValueT, Hash, KeyEqual>::put(const KeyT & key, const ValueT & value)
+{
+    auto found = _index.find(key);
+    if (found != _index.end())
+    {
+        _nodes[found->second].value = value;
+        _touch(found->second);
+        return false;
+    }
+    size_t node = _acquire();
+    _nodes[node].key = key;
+    _nodes[node].value = value;
+    _nodes[node].referenced = false;
+    _nodes[node].used = true;
+    if (_policy == LRU_EVICTION)
+    {
+        _pushFront(node);
+    }
+    _index.insert(key, node);
+    return true;
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual>
+bool LruCache<KeyT, ValueT, Hash, KeyEqual>::containsKey(const KeyT & key) const
+{
+    return _index.containsKey(key);
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual>
+bool LruCache<KeyT, ValueT, Hash, KeyEqual>::erase(const KeyT & key)
+{
+    auto found = _index.find(key);
+    if (found == _index.end())
+    {
+        return false;
+    }
+    _release(found->second);
+    return true;
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual>
+void LruCache<KeyT, ValueT, Hash, KeyEqual>::clear()
+{
+    _index.clear();
+    _nodes.clear();
+    _head = NO_NODE;
+    _tail = NO_NODE;
+    _free = NO_NODE;
+    _hand = 0;
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual>
+size_t LruCache<KeyT, ValueT, Hash, KeyEqual>::size() const
+{
+    return _index.size();
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual>
+size_t LruCache<KeyT, ValueT, Hash, KeyEqual>::capacity() const
+{
+    return _capacity;
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual>
+EvictionPolicy LruCache<KeyT, ValueT, Hash, KeyEqual>::policy() const
+{
+    return _policy;
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual>
+CacheStats LruCache<KeyT, ValueT, Hash, KeyEqual>::stats() const
+{
+    return _stats;
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual>
+void LruCache<KeyT, ValueT, Hash, KeyEqual>::_touch(size_t node)
+{
+    if (_policy == CLOCK_EVICTION)
+    {
+        _nodes[node].referenced = true;
+    }
+    else if (node != _head)
+    {
+        _unlink(node);
+        _pushFront(node);
+    }
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual>
+void LruCache<KeyT, ValueT, Hash, KeyEqual>::_pushFront(size_t node)
+{
+    _nodes[node].previous = NO_NODE;
+    _nodes[node].next = _head;
+    if (_head != NO_NODE)
+    {
+        _nodes[_head].previous = node;
+    }
+    _head = node;
+    if (_tail == NO_NODE)
+    {
+        _tail = node;
+    }
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual>
+void LruCache<KeyT, ValueT, Hash, KeyEqual>::_unlink(size_t node)
+{
+    size_t previous = _nodes[node].previous;
+    size_t next = _nodes[node].next;
+    (previous == NO_NODE ? _head : _nodes[previous].next) = next;
+    (next == NO_NODE ? _tail : _nodes[next].previous) = previous;
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual>
+size_t LruCache<KeyT, ValueT, Hash, KeyEqual>::_evict()
+{
+    size_t victim = _tail;
+    if (_policy == CLOCK_EVICTION)
+    {
+        // every pass over a referenced pair clears its bit, so the hand stops within one full circle
+        while (!_nodes[_hand].used or _nodes[_hand].referenced)
+        {
+            _nodes[_hand].referenced = false;
+            _hand = (_hand + 1) % _nodes.size();
+        }
+        victim = _hand;
+        _hand = (_hand + 1) % _nodes.size();
+    }
+    _stats.evictions++;
+    _release(victim);
+    return victim;
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual>
+size_t LruCache<KeyT, ValueT, Hash, KeyEqual>::_acquire()
+{
+    if (_free == NO_NODE and _nodes.size() < _capacity)
+    {
+        _nodes.push_back(Node{KeyT(), ValueT(), NO_NODE, NO_NODE, false, false});
+        return _nodes.size() - 1;
+    }
+    if (_free == NO_NODE)
+    {
+        _evict();
+    }
+    size_t node = _free;
+    _free = _nodes[node].next;
+    return node;
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual>
+void LruCache<KeyT, ValueT, Hash, KeyEqual>::_release(size_t node)
+{
+    _index.erase(_nodes[node].key);
+    if (_policy == LRU_EVICTION)
+    {
+        _unlink(node);
+    }
+    _nodes[node].used = false;
+    _nodes[node].referenced = false;
+    _nodes[node].next = _free;
+    _free = node;
+}
+
+//=================ShardedLruCache implementation==================//
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual>
+ShardedLruCache<KeyT, ValueT, Hash, KeyEqual>::ShardedLruCache(size_t capacity, EvictionPolicy policy,
+                                                               size_t shards, const Hash & hash,
+                                                               const KeyEqual & equal) :
+        _shardCount(1), _hash(hash)
+{
+    if (capacity == 0)
+    {
+        throw (std::invalid_argument(CACHE_CAPACITY_ERR));
+    }
+    while (_shardCount < shards)
+    {
+        _shardCount <<= 1;
+    }
+    // a deque never moves its elements, so it can hold the (immovable) locks
+    for (size_t i = 0; i < _shardCount; i++)
+    {
+        _shards.emplace_back((capacity + _shardCount - 1) / _shardCount, policy, hash, equal);
+    }
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual>
+bool ShardedLruCache<KeyT, ValueT, Hash, KeyEqual>::get(const KeyT & key, ValueT & value)
+{
+    Shard & shard = _shardOf(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    return shard.cache.get(key, value);
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual>
+bool ShardedLruCache<KeyT, ValueT, Hash, KeyEqual>::put(const KeyT & key, const ValueT & value)
+{
+    Shard & shard = _shardOf(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    return shard.cache.put(key, value);
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual>
+bool ShardedLruCache<KeyT, ValueT, Hash, KeyEqual>::containsKey(const KeyT & key) const
+{
+    Shard & shard = _shardOf(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    return shard.cache.containsKey(key);
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual>
+bool ShardedLruCache<KeyT, ValueT, Hash, KeyEqual>::erase(const KeyT & key)
+{
+    Shard & shard = _shardOf(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    return shard.cache.erase(key);
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual>
+void ShardedLruCache<KeyT, ValueT, Hash, KeyEqual>::clear()
+{
+    for (Shard & shard : _shards)
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.cache.clear();
+    }
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual>
+size_t ShardedLruCache<KeyT, ValueT, Hash, KeyEqual>::size() const
+{
+    size_t total = 0;
+    for (const Shard & shard : _shards)
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        total += shard.cache.size();
+    }
+    return total;
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual>
+size_t ShardedLruCache<KeyT, ValueT, Hash, KeyEqual>::capacity() const
+{
+    return _shards.front().cache.capacity() * _shardCount;
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual>
+CacheStats ShardedLruCache<KeyT, ValueT, Hash, KeyEqual>::stats() const
+{
+    CacheStats total;
+    for (const Shard & shard : _shards)
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        CacheStats stats = shard.cache.stats();
+        total.hits += stats.hits;
+        total.misses += stats.misses;
+        total.evictions += stats.evictions;
+    }
+    return total;
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual>
+typename ShardedLruCache<KeyT, ValueT, Hash, KeyEqual>::Shard &
+ShardedLruCache<KeyT, ValueT, Hash, KeyEqual>::_shardOf(const KeyT & key) const
+{
+    size_t hash = mixHash(_hash(key));
+    size_t index = static_cast<size_t>((static_cast<uint64_t>(hash) * SHARD_MIX) >> SHARD_SHIFT) & (_shardCount - 1);
+    return const_cast<Shard &>(_shards[index]);
+}
+
+#endif
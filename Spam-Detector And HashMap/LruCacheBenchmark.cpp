@@ -0,0 +1,207 @@
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <thread>
+#include <mutex>
+#include <vector>
+#include "LruCache.hpp"
+
+static const size_t KEY_RANGE = 1 << 20;
+
+static const size_t TRACE_LENGTH = 1 << 22;
+
+static const size_t MAX_THREADS = 16;
+
+static const uint64_t RANDOM_SEED = 20240601;
+
+/**
+ * An odd multiplier scattering the ranks of the Zipf distribution over the keys, so hot keys are not neighbours
+ */
+static const uint64_t KEY_SCATTER = 0x9e3779b97f4a7c15ull;
+
+/**
+ * Skews of the Zipf distributions replayed: the higher, the more the accesses concentrate on the hottest keys
+ */
+static const double SKEWS[] = {0.7, 0.9, 0.99, 1.2};
+
+/**
+ * Capacities of the caches, as fractions of KEY_RANGE
+ */
+static const double CAPACITY_FRACTIONS[] = {0.01, 0.1};
+
+/**
+ * An LruCache shared the naive way, behind one global mutex
+ */
+class GlobalLockCache
+{
+public:
+
+    GlobalLockCache(size_t capacity, EvictionPolicy policy) : _cache(capacity, policy)
+    {}
+
+    bool get(uint64_t key, uint64_t & value)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _cache.get(key, value);
+    }
+
+    bool put(uint64_t key, uint64_t value)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _cache.put(key, value);
+    }
+
+private:
+
+    std::mutex _mutex;
+
+    LruCache<uint64_t, uint64_t> _cache;
+};
+
+/**
+ * Draws a trace of accesses to KEY_RANGE keys whose popularity follows a Zipf distribution:
+ * the key of rank r is accessed with probability proportional to 1 / r^skew
+ * @param skew - skew of the distribution
+ * @param length - number of accesses
+ * @param seed - seed of the random generator
+ * @return the keys accessed, in order
+ */
+std::vector<uint64_t> zipfTrace(double skew, size_t length, uint64_t seed)
+{
+    std::vector<double> cumulative(KEY_RANGE);
+    double total = 0;
+    for (size_t rank = 0; rank < KEY_RANGE; rank++)
+    {
+        total += 1.0 / std::pow(static_cast<double>(rank + 1), skew);
+        cumulative[rank] = total;
+    }
+    std::mt19937_64 generator(seed);
+    std::uniform_real_distribution<double> uniform(0, total);
+    std::vector<uint64_t> trace(length);
+    for (uint64_t & key : trace)
+    {
+        size_t rank = std::lower_bound(cumulative.begin(), cumulative.end(), uniform(generator)) - cumulative.begin();
+        key = static_cast<uint64_t>(std::min(rank, KEY_RANGE - 1)) * KEY_SCATTER;
+    }
+    return trace;
+}
+
+/**
+ * Replays the trace against the cache, putting every key that misses (a read-through cache)
+ * @param cache - the cache
+ * @param trace - the keys accessed
+ * @param begin - first access to replay
+ * @param end - one past the last access to replay
+ */
+template<class Cache>
+void replay(Cache & cache, const std::vector<uint64_t> & trace, size_t begin, size_t end)
+{
+    uint64_t sum = 0;
+    for (size_t i = begin; i < end; i++)
+    {
+        uint64_t value;
+        if (cache.get(trace[i], value))
+        {
+            sum += value;
+        }
+        else
+        {
+            cache.put(trace[i], trace[i]);
+        }
+    }
+    volatile uint64_t sink = sum;
+    (void) sink;
+}
+
+/**
+ * Replays the trace against a single threaded cache
+ * @param trace - the keys accessed
+ * @param capacity - capacity of the cache
+ * @param policy - eviction policy of the cache
+ * @param hitRatio - set to the fraction of the accesses that hit
+ * @return average time of an access in nanoseconds
+ */
+double measureSingle(const std::vector<uint64_t> & trace, size_t capacity, EvictionPolicy policy, double & hitRatio)
+{
+    LruCache<uint64_t, uint64_t> cache(capacity, policy);
+    auto start = std::chrono::steady_clock::now();
+    replay(cache, trace, 0, trace.size());
+    auto stop = std::chrono::steady_clock::now();
+    hitRatio = cache.stats().hitRatio();
+    return std::chrono::duration<double, std::nano>(stop - start).count() / static_cast<double>(trace.size());
+}
+
+/**
+ * Replays the trace against a shared cache, split evenly between the given number of threads
+ * @return throughput in millions of accesses per second
+ */
+template<class Cache>
+double measureShared(Cache & cache, const std::vector<uint64_t> & trace, size_t threads)
+{
+    std::vector<std::thread> workers;
+    size_t share = trace.size() / threads;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t t = 0; t < threads; t++)
+    {
+        workers.emplace_back([&cache, &trace, t, share]()
+        {
+            replay(cache, trace, t * share, (t + 1) * share);
+        });
+    }
+    for (std::thread & worker : workers)
+    {
+        worker.join();
+    }
+    auto stop = std::chrono::steady_clock::now();
+    double seconds = std::chrono::duration<double>(stop - start).count();
+    return static_cast<double>(threads * share) / seconds / 1e6;
+}
+
+/**
+ * Replays Zipf distributed traces against LruCache in LRU and CLOCK modes, printing the hit ratio and the
+ * time of an access for a few skews and capacities, then measures the throughput of ShardedLruCache against
+ * one cache behind a global mutex from 1 to MAX_THREADS threads
+ */
+int main()
+{
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "keys: " << KEY_RANGE << ", accesses per trace: " << TRACE_LENGTH << "\n";
+    std::cout << std::setw(8) << "skew" << std::setw(12) << "capacity" << std::setw(12) << "LRU hits"
+              << std::setw(12) << "LRU ns" << std::setw(12) << "CLOCK hits" << std::setw(12) << "CLOCK ns" << "\n";
+    for (double skew : SKEWS)
+    {
+        std::vector<uint64_t> trace = zipfTrace(skew, TRACE_LENGTH, RANDOM_SEED);
+        for (double fraction : CAPACITY_FRACTIONS)
+        {
+            size_t capacity = static_cast<size_t>(fraction * KEY_RANGE);
+            double lruHits;
+            double clockHits;
+            double lruTime = measureSingle(trace, capacity, LRU_EVICTION, lruHits);
+            double clockTime = measureSingle(trace, capacity, CLOCK_EVICTION, clockHits);
+            std::cout << std::setw(8) << skew << std::setw(12) << capacity << std::setw(12) << lruHits
+                      << std::setw(12) << lruTime << std::setw(12) << clockHits << std::setw(12) << clockTime
+                      << "\n";
+        }
+    }
+
+    std::cout << "\nhardware threads: " << std::thread::hardware_concurrency() << "\n";
+    std::cout << "skew 0.99, capacity " << KEY_RANGE / 10 << " (Mops/s)\n";
+    std::cout << std::setw(10) << "threads" << std::setw(14) << "sharded LRU" << std::setw(14) << "sharded CLOCK"
+              << std::setw(14) << "global lock" << "\n";
+    std::vector<uint64_t> trace = zipfTrace(0.99, TRACE_LENGTH, RANDOM_SEED);
+    for (size_t threads = 1; threads <= MAX_THREADS; threads *= 2)
+    {
+        ShardedLruCache<uint64_t, uint64_t> shardedLru(KEY_RANGE / 10, LRU_EVICTION);
+        ShardedLruCache<uint64_t, uint64_t> shardedClock(KEY_RANGE / 10, CLOCK_EVICTION);
+        GlobalLockCache global(KEY_RANGE / 10, LRU_EVICTION);
+        double lruThroughput = measureShared(shardedLru, trace, threads);
+        double clockThroughput = measureShared(shardedClock, trace, threads);
+        double globalThroughput = measureShared(global, trace, threads);
+        std::cout << std::setw(10) << threads << std::setw(14) << lruThroughput << std::setw(14)
+                  << clockThroughput << std::setw(14) << globalThroughput << "\n";
+    }
+    return 0;
+}
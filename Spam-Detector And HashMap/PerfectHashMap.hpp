@@ -0,0 +1,675 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "KeyHash.hpp"
+
+
+#ifndef CPP_EX3_PERFECTHASHMAP_HPP
+#define CPP_EX3_PERFECTHASHMAP_HPP
+
+static const size_t PARTITION_KEYS = 1 << 18;
+
+static const double PERFECT_BUCKET_FACTOR = 4.5;
+
+static const double PERFECT_LOAD = 0.99;
+
+static const uint32_t DENSE_KEYS_THRESHOLD = static_cast<uint32_t>(0.6 * 4294967296.0);
+
+static const double DENSE_BUCKETS = 0.3;
+
+static const uint64_t MAX_PILOT = 1 << 20;
+
+static const int MAX_BUILD_ATTEMPTS = 8;
+
+static const uint64_t PERFECT_SEED = 0x7e5f1a2b3c4d5e6full;
+
+static const uint64_t PILOT_SEED = 0x94d049bb133111ebull;
+
+static const unsigned int WORD_BITS = 64;
+
+static const unsigned int FREE_SLOT_BITS = 32;
+
+static const unsigned int PARTITION_HEADER_BITS = 6 * 64;
+
+static const char *const PERFECT_BUILD_ERR = "Perfect hash map build failed (are the keys distinct?)";
+
+static const char *const PERFECT_NOT_CONTAIN_ERR = "Perfect hash map dose not contain the key";
+
+/**
+ * Unsigned integers of a fixed number of bits (the width of the largest one), packed into 64 bit words
+ */
+class PackedArray
+{
+public:
+
+    /**
+     * Packs the given values
+     */
+    explicit PackedArray(const std::vector<uint64_t> & values = std::vector<uint64_t>()) : _width(0),
+                                                                                         _size(values.size())
+    {
+        uint64_t largest = 0;
+        for (uint64_t value : values)
+        {
+            largest = std::max(largest, value);
+        }
+        while (_width < WORD_BITS and (largest >> _width) != 0)
+        {
+            _width++;
+        }
+        _words.assign((_size * _width + WORD_BITS - 1) / WORD_BITS + 1, 0);
+        for (size_t i = 0; i < _size and _width != 0; i++)
+        {
+            size_t bit = i * _width;
+            _words[bit / WORD_BITS] |= values[i] << (bit % WORD_BITS);
+            if (bit % WORD_BITS + _width > WORD_BITS)
+            {
+                _words[bit / WORD_BITS + 1] |= values[i] >> (WORD_BITS - bit % WORD_BITS);
+            }
+        }
+    }
+
+    uint64_t operator[](size_t index) const
+    {
+        if (_width == 0)
+        {
+            return 0;
+        }
+        size_t bit = index * _width;
+        uint64_t value = _words[bit / WORD_BITS] >> (bit % WORD_BITS);
+        if (bit % WORD_BITS + _width > WORD_BITS)
+        {
+            value |= _words[bit / WORD_BITS + 1] << (WORD_BITS - bit % WORD_BITS);
+        }
+        return _width == WORD_BITS ? value : value & ((uint64_t(1) << _width) - 1);
+    }
+
+    /**
+     * @return number of bits the values take
+     */
+    size_t bits() const
+    {
+        return _words.size() * WORD_BITS;
+    }
+
+private:
+
+    std::vector<uint64_t> _words;
+
+    unsigned int _width;
+
+    size_t _size;
+};
+
+template<class ValueT>
+/**
+ * A read-only map over a key set known up front, indexed by a minimal perfect hash function in the style of
+ * PTHash: every key is sent to a bucket, and every bucket gets the smallest "pilot" number that sends all its
+ * keys to slots no other key took. A lookup hashes the key once, reads the pilot of its bucket and computes
+ * its slot - exactly one probe, no collisions, no empty slots: the n pairs are stored in n slots.
+ * The index costs about 3 bits per key (the pilots, packed). Keys are checked on lookup, so keys outside
+ * the set are reported missing.
+ * The keys are split by hash code into partitions of about PARTITION_KEYS keys, each with its own
+ * pilots, which are built in parallel.
+ * @tparam ValueT - represents a value for the map
+ */
+class PerfectHashMap
+{
+public:
+
+    /**
+     * iterator to the map, it yields (key, value) pairs by value
+     */
+    class Iterator
+    {
+    public:
+
+        typedef std::pair<std::string_view, ValueT> value_type;
+        typedef value_type reference;
+        typedef const value_type *pointer;
+        typedef std::ptrdiff_t difference_type;
+        typedef std::forward_iterator_tag iterator_category;
+
+        Iterator(const PerfectHashMap *map, size_t slot) : _map(map), _slot(slot)
+        {}
+
+        value_type operator*() const
+        {
+            return value_type(_map->_keyAt(_slot), _map->_slots[_slot].value);
+        }
+
+        Iterator & operator++()
+        {
+            _slot++;
+            return *this;
+        }
+
+        Iterator operator++(int)
+        {
+            Iterator previous = *this;
+            _slot++;
+            return previous;
+        }
+
+        bool operator==(const Iterator & other) const
+        {
+            return _map == other._map and _slot == other._slot;
+        }
+
+        bool operator!=(const Iterator & other) const
+        {
+            return !(*this == other);
+        }
+
+    private:
+
+        const PerfectHashMap *_map;
+
+        size_t _slot;
+    };
+
+    typedef Iterator const_iterator;
+
+    /**
+     * Builds the map from the pairs of the given map
+     * @param map - a map with string keys (std::string or std::string_view), e.g. the one initializeMap built
+     * @param threads - number of threads to build with, 0 for one per hardware thread
+     */
+    template<class Map>
+    explicit PerfectHashMap(const Map & map, size_t threads = 0);
+
+    /**
+     * @return True if the given key contained in the map and false otherwise
+     */
+    bool containsKey(std::string_view key) const;
+
+    /**
+     * @param key - key value
+     * @return the value of the key
+     */
+    const ValueT & at(std::string_view key) const;
+
+    /**
+     * @return number of pairs in the map
+     */
+    size_t size() const;
+
+    /**
+     * @return true if the map is empty and false otherwise
+     */
+    bool empty() const;
+
+    /**
+     * @return number of bits of the index (pilots, remapped slots and partition headers), not counting the
+     * keys and values themselves
+     */
+    size_t indexBits() const;
+
+    const_iterator begin() const;
+
+    const_iterator end() const;
+
+private:
+
+    /**
+     * The perfect hash function of one partition of the keys
+     */
+    struct Partition
+    {
+        uint64_t offset;
+
+        uint64_t size;
+
+        uint64_t tableSize;
+
+        uint64_t buckets;
+
+        uint64_t denseBuckets;
+
+        PackedArray pilots;
+
+        /**
+         * The table has a little slack (PERFECT_LOAD); a key that lands at or past size is moved to
+         * freeSlots[position - size], one of the slots below size no key landed on
+         */
+        std::vector<uint32_t> freeSlots;
+    };
+
+    WyHash _hash;
+
+    std::vector<Partition> _partitions;
+
+    std::string _pool;
+
+    /**
+     * A key (in the pool) and its value, together so a lookup reads one slot
+     */
+    struct Slot
+    {
+        uint64_t keyOffset;
+
+        uint64_t keyLength;
+
+        ValueT value;
+    };
+
+    std::vector<Slot> _slots;
+
+    /**
+     * Builds the index with the given seed
+     * @return false if some partition could not be built (two keys with the same hash code)
+     */
+    bool _build(const std::vector<std::string_view> & keys, uint64_t seed, size_t threads,
+                std::vector<size_t> & slotOf);
+
+    /**
+     * Builds the perfect hash function of one partition
+     * @param hashes - the mixed hash codes of the keys of the partition
+     * @param partition - the partition to build, its offset and size are set
+     * @param positions - set to the slot (within the partition) of every key
+     * @return false if two keys of the partition have the same hash code
+     */
+    static bool _buildPartition(const std::vector<uint64_t> & hashes, Partition & partition,
+                                std::vector<uint64_t> & positions);
+
+    /**
+     * @return the slot of the key, which holds the key only if the key is in the map
+     */
+    size_t _slotOf(std::string_view key) const;
+
+    /**
+     * @return the key stored in the given slot
+     */
+    std::string_view _keyAt(size_t slot) const;
+
+    static uint64_t _bucketOf(uint64_t hash, uint64_t buckets, uint64_t denseBuckets);
+
+    static uint64_t _positionOf(uint64_t hash, uint64_t pilot, uint64_t tableSize);
+
+    /**
+     * A bijective 64 bit mixer (the murmur3 finalizer)
+     */
+    static uint64_t _mix(uint64_t value);
+
+    /**
+     * @return value scaled from [0, 2^64) to [0, range)
+     */
+    static uint64_t _scale(uint64_t value, uint64_t range);
+
+    /**
+     * Runs task(i) for every i in [0, tasks), on up to the given number of threads
+     */
+    template<class F>
+    static void _parallelFor(size_t threads, size_t tasks, F && task);
+};
+
+//=================PerfectHashMap implementation==================//
+
+template<class ValueT>
+template<class Map>
+PerfectHashMap<ValueT>::PerfectHashMap(const Map & map, size_t threads)
+{
+    if (threads == 0)
+    {
+        threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+    }
+    std::vector<std::string_view> keys;
+    std::vector<ValueT> values;
+    for (const auto & pair : map)
+    {
+        keys.emplace_back(pair.first);
+        values.push_back(pair.second);
+    }
+
+    std::vector<size_t> slotOf(keys.size());
+    for (int attempt = 0; attempt < MAX_BUILD_ATTEMPTS; attempt++)
+    {
+        if (_build(keys, PERFECT_SEED + attempt, threads, slotOf))
+        {
+            std::vector<size_t> keyAt(keys.size());
+            size_t poolSize = 0;
+            for (size_t i = 0; i < keys.size(); i++)
+            {
+                keyAt[slotOf[i]] = i;
+                poolSize += keys[i].size();
+            }
+            _pool.reserve(poolSize);
+            _slots.reserve(keys.size());
+            for (size_t slot = 0; slot < keys.size(); slot++)
+            {
+                std::string_view slotKey = keys[keyAt[slot]];
+                _slots.push_back({_pool.size(), slotKey.size(), std::move(values[keyAt[slot]])});
+                _pool.append(slotKey);
+            }
+            return;
+        }
+    }
+    throw (std::invalid_argument(PERFECT_BUILD_ERR));
+}
+
+template<class ValueT>
+bool PerfectHashMap<ValueT>::containsKey(std::string_view key) const
+{
+    return !_slots.empty() and _keyAt(_slotOf(key)) == key;
+}
+
+template<class ValueT>
+const ValueT & PerfectHashMap<ValueT>::at(std::string_view key) const
+{
+    if (_slots.empty())
+    {
+        throw (std::invalid_argument(PERFECT_NOT_CONTAIN_ERR));
+    }
+    size_t slot = _slotOf(key);
+    if (_keyAt(slot) != key)
+    {
+        throw (std::invalid_argument(PERFECT_NOT_CONTAIN_ERR));
+    }
+    return _slots[slot].value;
+}
+
+template<class ValueT>
+size_t PerfectHashMap<ValueT>::size() const
+{
+    return _slots.size();
+}
+
+template<class ValueT>
+bool PerfectHashMap<ValueT>::empty() const
+{
+    return _slots.empty();
+}
+
+template<class ValueT>
+size_t PerfectHashMap<ValueT>::indexBits() const
+{
+    size_t bits = 0;
+    for (const Partition & partition : _partitions)
+    {
+        bits += PARTITION_HEADER_BITS + partition.pilots.bits() + partition.freeSlots.size() * FREE_SLOT_BITS;
+    }
+    return bits;
+}
+
+template<class ValueT>
+typename PerfectHashMap<ValueT>::const_iterator PerfectHashMap<ValueT>::begin() const
+{
+    return Iterator(this, 0);
+}
+
+template<class ValueT>
+typename PerfectHashMap<ValueT>::const_iterator PerfectHashMap<ValueT>::end() const
+{
+    return Iterator(this, _slots.size());
+}
+
+template<class ValueT>
+bool PerfectHashMap<ValueT>::_build(const std::vector<std::string_view> & keys, uint64_t seed, size_t threads,
+                                    std::vector<size_t> & slotOf)
+{
+    _hash = WyHash(seed);
+    size_t count = keys.size();
+    size_t partitions = (count + PARTITION_KEYS - 1) / PARTITION_KEYS;
+
+    std::vector<uint64_t> hashes(count);
+    _parallelFor(threads, partitions, [&](size_t task)
+    {
+        for (size_t i = task * PARTITION_KEYS; i < std::min(count, (task + 1) * PARTITION_KEYS); i++)
+        {
+            hashes[i] = _hash(keys[i]);
+        }
+    });
+
+    // group the keys by partition (a counting sort)
+    std::vector<size_t> starts(partitions + 1, 0);
+    for (uint64_t hash : hashes)
+    {
+        starts[_scale(hash, partitions) + 1]++;
+    }
+    for (size_t i = 0; i < partitions; i++)
+    {
+        starts[i + 1] += starts[i];
+    }
+    std::vector<size_t> members(count);
+    std::vector<size_t> filled(starts.begin(), starts.end() - 1);
+    for (size_t i = 0; i < count; i++)
+    {
+        members[filled[_scale(hashes[i], partitions)]++] = i;
+    }
+
+    _partitions.assign(partitions, Partition());
+    std::atomic<bool> built(true);
+    _parallelFor(threads, partitions, [&](size_t index)
+    {
+        Partition & partition = _partitions[index];
+        partition.offset = starts[index];
+        partition.size = starts[index + 1] - starts[index];
+        std::vector<uint64_t> local(partition.size), positions;
+        for (size_t i = 0; i < partition.size; i++)
+        {
+            local[i] = _mix(hashes[members[partition.offset + i]]);
+        }
+        if (!_buildPartition(local, partition, positions))
+        {
+            built = false;
+            return;
+        }
+        for (size_t i = 0; i < partition.size; i++)
+        {
+            slotOf[members[partition.offset + i]] = partition.offset + positions[i];
+        }
+    });
+    return built;
+}
+
+template<class ValueT>
+bool PerfectHashMap<ValueT>::_buildPartition(const std::vector<uint64_t> & hashes, Partition & partition,
+                                             std::vector<uint64_t> & positions)
+{
+    uint64_t size = partition.size;
+    partition.tableSize = std::max<uint64_t>(size, static_cast<uint64_t>(std::ceil(size / PERFECT_LOAD)));
+    partition.buckets = std::max<uint64_t>(1, static_cast<uint64_t>(
+            std::ceil(PERFECT_BUCKET_FACTOR * size / std::log2(std::max<uint64_t>(size, 2)))));
+    partition.denseBuckets = static_cast<uint64_t>(partition.buckets * DENSE_BUCKETS);
+
+    // the keys sorted by bucket, and by hash code within a bucket to find equal hash codes
+    std::vector<std::pair<uint64_t, size_t>> order(size);
+    for (size_t i = 0; i < size; i++)
+    {
+        order[i] = {_bucketOf(hashes[i], partition.buckets, partition.denseBuckets), i};
+    }
+    std::sort(order.begin(), order.end(), [&hashes](const std::pair<uint64_t, size_t> & a,
+                                                    const std::pair<uint64_t, size_t> & b)
+    {
+        return a.first != b.first ? a.first < b.first : hashes[a.second] < hashes[b.second];
+    });
+    std::vector<std::pair<size_t, size_t>> ranges;
+    for (size_t begin = 0, end; begin < size; begin = end)
+    {
+        for (end = begin + 1; end < size and order[end].first == order[begin].first; end++)
+        {
+            if (hashes[order[end].second] == hashes[order[end - 1].second])
+            {
+                return false;
+            }
+        }
+        ranges.emplace_back(begin, end);
+    }
+    // the largest buckets first, while the table is still empty enough to place them
+    std::stable_sort(ranges.begin(), ranges.end(), [](const std::pair<size_t, size_t> & a,
+                                                      const std::pair<size_t, size_t> & b)
+    {
+        return a.second - a.first > b.second - b.first;
+    });
+
+    std::vector<bool> taken(partition.tableSize, false);
+    std::vector<uint64_t> pilots(partition.buckets, 0), trial;
+    positions.assign(size, 0);
+    for (const std::pair<size_t, size_t> & range : ranges)
+    {
+        uint64_t pilot = 0;
+        for (;; pilot++)
+        {
+            if (pilot > MAX_PILOT)
+            {
+                return false;
+            }
+            trial.clear();
+            bool free = true;
+            for (size_t i = range.first; i < range.second and free; i++)
+            {
+                uint64_t position = _positionOf(hashes[order[i].second], pilot, partition.tableSize);
+                free = !taken[position] and std::find(trial.begin(), trial.end(), position) == trial.end();
+                trial.push_back(position);
+            }
+            if (free)
+            {
+                break;
+            }
+        }
+        pilots[order[range.first].first] = pilot;
+        for (size_t i = range.first; i < range.second; i++)
+        {
+            taken[trial[i - range.first]] = true;
+            positions[order[i].second] = trial[i - range.first];
+        }
+    }
+    partition.pilots = PackedArray(pilots);
+
+    // make the function minimal: send the keys past size to the slots below size that no key took
+    std::vector<uint64_t> remapped(partition.tableSize - size, 0);
+    uint64_t freeSlot = 0;
+    for (uint64_t position = size; position < partition.tableSize; position++)
+    {
+        if (taken[position])
+        {
+            while (taken[freeSlot])
+            {
+                freeSlot++;
+            }
+            remapped[position - size] = freeSlot++;
+        }
+    }
+    partition.freeSlots.assign(remapped.begin(), remapped.end());
+    for (uint64_t & position : positions)
+    {
+        if (position >= size)
+        {
+            position = remapped[position - size];
+        }
+    }
+    return true;
+}
+
+template<class ValueT>
+size_t PerfectHashMap<ValueT>::_slotOf(std::string_view key) const
+{
+    uint64_t hash = _hash(key);
+    const Partition & partition = _partitions[_scale(hash, _partitions.size())];
+    hash = _mix(hash);
+    uint64_t position = _positionOf(hash, partition.pilots[_bucketOf(hash, partition.buckets, partition.denseBuckets)],
+                                    partition.tableSize);
+    if (position >= partition.size)
+    {
+        position = partition.freeSlots[position - partition.size];
+    }
+    return partition.offset + position;
+}
+
+template<class ValueT>
+std::string_view PerfectHashMap<ValueT>::_keyAt(size_t slot) const
+{
+    return std::string_view(_pool.data() + _slots[slot].keyOffset, _slots[slot].keyLength);
+}
+
+template<class ValueT>
+uint64_t PerfectHashMap<ValueT>::_bucketOf(uint64_t hash, uint64_t buckets, uint64_t denseBuckets)
+{
+    // about 60% of the keys go to the first 30% of the buckets: the few large buckets are placed first,
+    // while it is easy, and the many small ones fill the table up
+    uint64_t high = hash >> 32;
+    if (static_cast<uint32_t>(hash) < DENSE_KEYS_THRESHOLD and denseBuckets != 0)
+    {
+        return (high * denseBuckets) >> 32;
+    }
+    return denseBuckets + ((high * (buckets - denseBuckets)) >> 32);
+}
+
+template<class ValueT>
+uint64_t PerfectHashMap<ValueT>::_positionOf(uint64_t hash, uint64_t pilot, uint64_t tableSize)
+{
+    return _scale(_mix(hash ^ _mix(pilot + PILOT_SEED)), tableSize);
+}
+
+template<class ValueT>
+uint64_t PerfectHashMap<ValueT>::_mix(uint64_t value)
+{
+    value ^= value >> 33;
+    value *= 0xff51afd7ed558ccdull;
+    value ^= value >> 33;
+    value *= 0xc4ceb9fe1a85ec53ull;
+    value ^= value >> 33;
+    return value;
+}
+
+template<class ValueT>
+uint64_t PerfectHashMap<ValueT>::_scale(uint64_t value, uint64_t range)
+{
+#ifdef __SIZEOF_INT128__
+    return static_cast<uint64_t>((static_cast<__uint128_t>(value) * range) >> 64);
+#else
+    return value % range;
+#endif
+}
+
+template<class ValueT>
+template<class F>
+void PerfectHashMap<ValueT>::_parallelFor(size_t threads, size_t tasks, F && task)
+{
+    std::atomic<size_t> next(0);
+    std::exception_ptr error;
+    std::atomic<bool> failed(false);
+    auto work = [&]()
+    {
+        try
+        {
+            for (size_t i = next++; i < tasks and !failed; i = next++)
+            {
+                task(i);
+            }
+        }
+        catch (...)
+        {
+            if (!failed.exchange(true))
+            {
+                error = std::current_exception();
+            }
+        }
+    };
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < std::min(threads, tasks); i++)
+    {
+        workers.emplace_back(work);
+    }
+    work();
+    for (std::thread & worker : workers)
+    {
+        worker.join();
+    }
+    if (error)
+    {
+        std::rethrow_exception(error);
+    }
+}
+
+#endif
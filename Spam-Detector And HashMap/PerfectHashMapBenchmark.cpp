@@ -0,0 +1,168 @@
+#include <iostream>
+#include <iomanip>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "HashMap.hpp"
+#include "PerfectHashMap.hpp"
+
+static const size_t KEY_COUNTS[] = {100000, 1000000, 4000000};
+
+static const size_t KEY_LENGTH = 24;
+
+static const size_t LOOKUPS = 4000000;
+
+static const uint64_t RANDOM_SEED = 20240601;
+
+static const char *const FIRST_LETTER = "a";
+
+static const int LETTERS = 26;
+
+static const size_t ALLOCATION_HEADER = alignof(std::max_align_t);
+
+/**
+ * Bytes allocated and not freed yet, by any operator new of the program
+ */
+static std::atomic<size_t> liveBytes(0);
+
+__attribute__((noinline)) void *operator new(size_t bytes)
+{
+    void *block = std::malloc(bytes + ALLOCATION_HEADER);
+    if (block == nullptr)
+    {
+        throw (std::bad_alloc());
+    }
+    *static_cast<size_t *>(block) = bytes;
+    liveBytes += bytes;
+    return static_cast<char *>(block) + ALLOCATION_HEADER;
+}
+
+__attribute__((noinline)) void operator delete(void *pointer) noexcept
+{
+    if (pointer != nullptr)
+    {
+        void *block = static_cast<char *>(pointer) - ALLOCATION_HEADER;
+        liveBytes -= *static_cast<size_t *>(block);
+        std::free(block);
+    }
+}
+
+void operator delete(void *pointer, size_t) noexcept
+{
+    operator delete(pointer);
+}
+
+/**
+ * Builds distinct random lower case keys of KEY_LENGTH, words separated by spaces like SpamDetector phrases
+ */
+std::vector<std::string> makeKeys(size_t count, std::mt19937_64 & generator)
+{
+    std::uniform_int_distribution<int> letter(0, LETTERS);
+    std::vector<std::string> keys(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        std::string & key = keys[i];
+        for (size_t j = 0; j + sizeof(size_t) * 2 < KEY_LENGTH; j++)
+        {
+            int drawn = letter(generator);
+            key.push_back(drawn == LETTERS ? ' ' : static_cast<char>(FIRST_LETTER[0] + drawn));
+        }
+        for (size_t rest = i; key.size() < KEY_LENGTH; rest /= LETTERS)
+        {
+            key.push_back(static_cast<char>(FIRST_LETTER[0] + rest % LETTERS));
+        }
+    }
+    return keys;
+}
+
+/**
+ * @return seconds the given function took
+ */
+template<class Function>
+double seconds(Function function)
+{
+    auto start = std::chrono::steady_clock::now();
+    function();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * @return millions of lookups per second of LOOKUPS random present keys in the given map
+ */
+template<class Map>
+double lookups(const Map & map, const std::vector<std::string> & keys, const std::vector<size_t> & order)
+{
+    volatile size_t sink = 0;
+    size_t found = 0;
+    double took = seconds([&]()
+    {
+        for (size_t index : order)
+        {
+            found += map.containsKey(keys[index]);
+        }
+    });
+    sink = sink + found;
+    return order.size() / took / 1e6;
+}
+
+/**
+ * Compares a PerfectHashMap built from a HashMap with the HashMap itself: build time (the perfect map on one
+ * thread and on all of them), heap bytes per key, and lookup throughput of present keys in random order
+ */
+int main()
+{
+    std::mt19937_64 generator(RANDOM_SEED);
+    size_t threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << std::setw(10) << "keys" << std::setw(12) << "map" << std::setw(12) << "build (s)"
+              << std::setw(12) << "bytes/key" << std::setw(14) << "index b/key" << std::setw(12) << "Mlookup/s"
+              << "\n";
+    for (size_t count : KEY_COUNTS)
+    {
+        std::vector<std::string> keys = makeKeys(count, generator);
+        std::vector<size_t> order(LOOKUPS);
+        std::uniform_int_distribution<size_t> pick(0, count - 1);
+        for (size_t & index : order)
+        {
+            index = pick(generator);
+        }
+
+        size_t before = liveBytes;
+        HashMap<std::string, int> map;
+        double built = seconds([&]()
+        {
+            for (size_t i = 0; i < count; i++)
+            {
+                map.insert(keys[i], static_cast<int>(i));
+            }
+        });
+        double mapBytes = static_cast<double>(liveBytes - before) / count;
+        std::cout << std::setw(10) << count << std::setw(12) << "HashMap" << std::setw(12) << built
+                  << std::setw(12) << mapBytes << std::setw(14) << "-" << std::setw(12)
+                  << lookups(map, keys, order) << "\n";
+
+        double serial = seconds([&]()
+        {
+            PerfectHashMap<int> perfect(map, 1);
+        });
+        before = liveBytes;
+        PerfectHashMap<int> *perfect = nullptr;
+        double parallel = seconds([&]()
+        {
+            perfect = new PerfectHashMap<int>(map, threads);
+        });
+        double perfectBytes = static_cast<double>(liveBytes - before) / count;
+        std::cout << std::setw(10) << count << std::setw(12) << "Perfect" << std::setw(12) << serial
+                  << std::setw(12) << perfectBytes << std::setw(14) << perfect->indexBits() / double(count)
+                  << std::setw(12) << lookups(*perfect, keys, order) << "\n";
+        std::cout << std::setw(10) << count << std::setw(12) << "Perfect x" + std::to_string(threads)
+                  << std::setw(12) << parallel << "\n";
+        delete perfect;
+    }
+    return 0;
+}
@@ -0,0 +1,914 @@
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "KeyHash.hpp"
+#include "HashMap.hpp"
+
+
+#ifndef CPP_EX3_PERSISTENTHASHMAP_HPP
+#define CPP_EX3_PERSISTENTHASHMAP_HPP
+
+/**
+ * Bits of the hash code consumed by every level of the trie, so every node has up to 2^5 = 32 slots
+ */
+static const unsigned int TRIE_BITS = 5;
+
+static const uint32_t TRIE_SLOT_MASK = (1u << TRIE_BITS) - 1;
+
+static const unsigned int TRIE_HASH_BITS = 64;
+
+/**
+ * The deepest a path goes: one level per TRIE_BITS bits of the hash code, and a collision node below them
+ */
+static const size_t TRIE_MAX_DEPTH = (TRIE_HASH_BITS + TRIE_BITS - 1) / TRIE_BITS + 1;
+
+template<class KeyT, class ValueT, class Hash = KeyHash<KeyT>, class KeyEqual = std::equal_to<>>
+/**
+ * A persistent hash map: a version never changes once made, insert and erase return a new version and leave
+ * this one as it is. A version is a hash array mapped trie (HAMT, in the CHAMP layout): every node takes
+ * TRIE_BITS bits of the hash code of a key and has a slot for each of their values, the slots in use are
+ * marked in two bitmaps, one for the pairs the node holds itself and one for its child nodes, which are packed
+ * in two arrays in the order of their slots. Keys whose 64 bit hash codes are all equal end up in a collision
+ * node, searched linearly.
+ * insert and erase copy only the nodes on the path to the key, O(log32 n) of them, and share every other node
+ * with this version, so copying a version is O(1) and keeping many versions that differ in a few keys costs
+ * little memory. Nodes are reference counted (std::shared_ptr) and freed with the last version using them.
+ * Versions are immutable, so any number of threads may read them, and make new versions of them, without locks.
+ * The form of a trie depends on its pairs only and not on the order they came in, so == skips the nodes two
+ * versions share.
+ * @tparam KeyT - represents a key for the map
+ * @tparam ValueT - represents a value for the map
+ * @tparam Hash - hash function of the keys
+ * @tparam KeyEqual - equality of the keys
+ */
+class PersistentHashMap
+{
+    using tuple = std::pair<KeyT, ValueT>;
+
+    /**
+     * A pair along with the (mixed) hash code of its key
+     */
+    struct Entry
+    {
+        size_t hash;
+
+        tuple pair;
+    };
+
+    struct Node;
+
+    using NodePtr = std::shared_ptr<Node>;
+
+    /**
+     * A node of the trie: the bitmap of the slots holding a pair and the bitmap of the slots holding a child
+     * node, with the pairs and the children in the order of their slots. A collision node has no bitmaps and
+     * holds pairs whose keys share one hash code, in no order.
+     */
+    struct Node
+    {
+        uint32_t dataMap = 0;
+
+        uint32_t nodeMap = 0;
+
+        bool collision = false;
+
+        std::vector<Entry> data;
+
+        std::vector<NodePtr> children;
+    };
+
+    /**
+     * iterator to a version of the map: a depth first walk of the trie, the pairs of a node before its children
+     */
+    class Iterator
+    {
+    public:
+
+        /**
+         * Default Constructor, an iterator of no map
+         */
+        Iterator() : _depth(0), _current(nullptr)
+        {}
+
+        /**
+         * Operator * overload
+         * @return const reference to current pair
+         */
+        const tuple & operator*() const
+        {
+            return _current->pair;
+        }
+
+        /**
+         * Operator -> overload
+         */
+        const tuple *operator->() const
+        {
+            return &_current->pair;
+        }
+
+        /**
+         * Prefix operator overload
+         */
+        Iterator & operator++()
+        {
+            _advance();
+            return *this;
+        }
+
+        /**
+         * Postfix operator overload
+         */
+        Iterator operator++(int)
+        {
+            Iterator r(*this);
+            _advance();
+            return r;
+        }
+
+        bool operator==(const Iterator & other) const
+        {
+            return _current == other._current;
+        }
+
+        bool operator!=(const Iterator & other) const
+        {
+            return !(*this == other);
+        }
+
+    private:
+
+        friend class PersistentHashMap;
+
+        /**
+         * A node on the path to the current pair: the next of its pairs and the next of its children to visit
+         */
+        struct Frame
+        {
+            const Node *node;
+
+            size_t data;
+
+            size_t child;
+        };
+
+        Frame _stack[TRIE_MAX_DEPTH];
+
+        size_t _depth;
+
+        const Entry *_current;
+
+        /**
+         * Adds a node to the path
+         */
+        void _push(const Node *node, size_t data, size_t child)
+        {
+            _stack[_depth++] = Frame{node, data, child};
+        }
+
+        /**
+         * Moves to the next pair of the walk, or to the end
+         */
+        void _advance()
+        {
+            while (_depth > 0)
+            {
+                Frame & top = _stack[_depth - 1];
+                if (top.data < top.node->data.size())
+                {
+                    _current = &top.node->data[top.data++];
+                    return;
+                }
+                if (top.child < top.node->children.size())
+                {
+                    _push(top.node->children[top.child++].get(), 0, 0);
+                    continue;
+                }
+                _depth--;
+            }
+            _current = nullptr;
+        }
+    };
+
+public:
+
+    typedef Iterator const_iterator;
+
+    typedef KeyT key_type;
+
+    typedef ValueT mapped_type;
+
+    typedef Hash hasher;
+
+    typedef KeyEqual key_equal;
+
+    /**
+     * Constructs an empty map
+     * @param hash - hash function of the keys
+     * @param equal - equality of the keys
+     */
+    explicit PersistentHashMap(const Hash & hash = Hash(), const KeyEqual & equal = KeyEqual());
+
+    /**
+     * Constructs a map of the (key,value) pairs of a range, for example of a HashMap; when a key repeats the
+     * first value is kept (as HashMap::insert does). The trie is built in place, without copying any path.
+     * @param first - iterator to the first pair (any iterator of pairs, HashMap's has no iterator_traits)
+     * @param last - iterator past the last pair
+     */
+    template<class InputIt, class = decltype(std::declval<InputIt &>()->first)>
+    PersistentHashMap(InputIt first, InputIt last);
+
+    /**
+     * @return a version with the given pair added, or this one if the key is already in it (the value is not
+     * replaced, as in HashMap::insert)
+     */
+    PersistentHashMap insert(const KeyT & key, const ValueT & value) const;
+
+    /**
+     * @return a version in which the key is mapped to the given value, whether it was in this one or not
+     */
+    PersistentHashMap insert_or_assign(const KeyT & key, const ValueT & value) const;
+
+    /**
+     * @return a version without the pair of the key, or this one if the key is not in it
+     */
+    PersistentHashMap erase(const KeyT & key) const;
+
+    /**
+     * @return True if the given key is in the map and false otherwise
+     */
+    bool containsKey(const KeyT & key) const;
+
+    /**
+     * containsKey by a value of another type, available when the hash function and the key equality are transparent
+     */
+    template<class K, class H = hasher, class E = key_equal, class = typename H::is_transparent,
+            class = typename E::is_transparent>
+    bool containsKey(const K & key) const;
+
+    /**
+     * @return the value of the key
+     * @throw std::invalid_argument if the key is not in the map
+     */
+    const ValueT & at(const KeyT & key) const;
+
+    /**
+     * at by a value of another type, available when the hash function and the key equality are transparent
+     */
+    template<class K, class H = hasher, class E = key_equal, class = typename H::is_transparent,
+            class = typename E::is_transparent>
+    const ValueT & at(const K & key) const;
+
+    /**
+     * const Operator [] overload, as at
+     */
+    const ValueT & operator[](const KeyT & key) const;
+
+    /**
+     * @return an iterator to the pair of the key, end() if the key is not in the map
+     */
+    const_iterator find(const KeyT & key) const;
+
+    /**
+     * @return number of pairs in the map
+     */
+    size_t size() const;
+
+    /**
+     * @return true if the map is empty and false otherwise
+     */
+    bool empty() const;
+
+    /**
+     * operator == overload, two versions are equal if they hold the same keys with equal values; the nodes
+     * they share are not visited
+     */
+    bool operator==(const PersistentHashMap & other) const;
+
+    /**
+     * operator != overload
+     */
+    bool operator!=(const PersistentHashMap & other) const;
+
+    /**
+     * This exchanges the contents of two maps
+     */
+    void swap(PersistentHashMap & other) noexcept;
+
+    /**
+     * @return an iterator to the first pair of the map
+     */
+    const_iterator begin() const;
+
+    /**
+     * @return an iterator past the last pair of the map
+     */
+    const_iterator end() const;
+
+    const_iterator cbegin() const;
+
+    const_iterator cend() const;
+
+private:
+
+    NodePtr _root;
+
+    size_t _size;
+
+    Hash _hash;
+
+    KeyEqual _equal;
+
+    /**
+     * @return the mixed hash code of a key, as HashMap's tables compute it
+     */
+    template<class K>
+    size_t _hashOf(const K & key) const
+    {
+        return mixHash(_hash(key));
+    }
+
+    /**
+     * @return the bit of the slot of a hash code in a node at the given depth (in bits of the hash code)
+     */
+    static uint32_t _bitOf(size_t hash, unsigned int shift)
+    {
+        return uint32_t(1) << ((static_cast<uint64_t>(hash) >> shift) & TRIE_SLOT_MASK);
+    }
+
+    /**
+     * @return the index in the packed array of the slot of the given bit: the number of slots before it in use
+     */
+    static size_t _indexOf(uint32_t map, uint32_t bit)
+    {
+        uint32_t before = map & (bit - 1);
+#if defined(__GNUC__) || defined(__clang__)
+        return static_cast<size_t>(__builtin_popcount(before));
+#else
+        size_t count = 0;
+        for (; before != 0; before &= before - 1)
+        {
+            count++;
+        }
+        return count;
+#endif
+    }
+
+    /**
+     * @return true if the node holds a single pair and no children, so its parent can hold the pair instead
+     */
+    static bool _isSingleton(const Node & node)
+    {
+        return node.nodeMap == 0 and node.data.size() == 1;
+    }
+
+    /**
+     * @return the given node if the caller owns it alone (owned), a copy of it to change otherwise
+     */
+    static NodePtr _editable(const NodePtr & node, bool owned)
+    {
+        return owned ? node : std::make_shared<Node>(*node);
+    }
+
+    /**
+     * @return the pair of the key in the trie, nullptr if it is not there
+     */
+    template<class K>
+    const Entry *_lookup(const K & key, size_t hash) const;
+
+    /**
+     * @return a node holding the two given pairs, whose keys have different hash codes or the same one
+     * @param shift - depth of the node, in bits of the hash code
+     */
+    static NodePtr _pairNode(Entry && first, Entry && second, unsigned int shift);
+
+    /**
+     * Adds a pair below the given node
+     * @param node - the node, not null
+     * @param entry - the pair to add
+     * @param shift - depth of the node, in bits of the hash code
+     * @param owned - true if no other version uses the node or any of its ancestors, so it is changed in place
+     * @param assign - true to replace the value when the key is there, false to keep it
+     * @param added - set to true if the key was not there
+     * @return the node after adding, the given one if nothing changed or it was changed in place
+     */
+    NodePtr _insert(const NodePtr & node, Entry && entry, unsigned int shift, bool owned, bool assign,
+                    bool & added) const;
+
+    /**
+     * Removes the pair of a key below the given node
+     * @param node - the node, not null
+     * @param key - key value
+     * @param hash - hash code of the key
+     * @param shift - depth of the node, in bits of the hash code
+     * @return the node after removing: the given one if the key is not there, nullptr if the node is left empty
+     */
+    NodePtr _erase(const NodePtr & node, const KeyT & key, size_t hash, unsigned int shift) const;
+
+    /**
+     * @return a version with the given pair added (see insert and insert_or_assign)
+     */
+    PersistentHashMap _with(const KeyT & key, const ValueT & value, bool assign) const;
+
+    /**
+     * @return true if the two tries hold the same pairs, comparing their nodes side by side (both built with
+     * the same stateless hash function, so of the same form) and skipping the nodes they share
+     */
+    bool _sameNodes(const Node & first, const Node & second) const;
+};
+
+//=================PersistentHashMap implementation==================//
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual>
+PersistentHashMap<KeyT, ValueT, Hash, KeyEqual>::PersistentHashMap(const Hash & hash, const KeyEqual & equal) :
+        _root(nullptr), _size(0), _hash(hash), _equal(equal)
+{
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual>
+template<class InputIt, class>
+PersistentHashMap<KeyT, ValueT, Hash, KeyEqual>::PersistentHashMap(InputIt first, InputIt last) :
+        PersistentHashMap()
+{
+    _root = std::make_shared<Node>();
+    for (; first != last; ++first)
+    {
+        // no other version exists yet, so every node is owned and changed in place
+        bool added = false;
+        _insert(_root, Entry{_hashOf(first->first), tuple(first->first, first->second)}, 0, true, false, added);
+        _size += added;
+    }
+    if (_size == 0)
+    {
+        _root = nullptr;
+    }
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual>
+PersistentHashMap<KeyT, ValueT, Hash, KeyEqual>
+PersistentHashMap<KeyT, ValueT, Hash, KeyEqual>::insert(const KeyT & key, const ValueT & value) const
+{
+    return _with(key, value, false);
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual>
+PersistentHashMap<KeyT, ValueT, Hash, KeyEqual>
+PersistentHashMap<KeyT, ValueT, Hash, KeyEqual>::insert_or_assign(const KeyT & key, const ValueT & value) const
+{
+    return _with(key, value, true);
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual>
+PersistentHashMap<KeyT, ValueT, Hash, KeyEqual>
+PersistentHashMap<KeyT, ValueT, Hash, KeyEqual>::erase(const KeyT & key) const
+{
+    PersistentHashMap version(*this);
+    if (_root == nullptr)
+    {
+        return version;
+    }
+    NodePtr root = _erase(_root, key, _hashOf(key), 0);
+    if (root != _root)
+    {
+        version._root = root;
+        version._size--;
+    }
+    return version;
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual>
+bool PersistentHashMap<KeyT, ValueT, Hash, KeyEqual>::containsKey(const KeyT & key) const
+{
+    return _lookup(key, _hashOf(key)) != nullptr;
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual>
+template<class K, class H, class E, class, class>
+bool PersistentHashMap<KeyT, ValueT, Hash, KeyEqual>::containsKey(const K & key) const
+{
+    return _lookup(key, _hashOf(key)) != nullptr;
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual>
+const ValueT & PersistentHashMap<KeyT, ValueT, Hash, KeyEqual>::at(const KeyT & key) const
+{
+    const Entry *entry = _lookup(key, _hashOf(key));
+    if (entry == nullptr)
+    {
+        throw (std::invalid_argument(NOT_CONTAIN_ERR));
+    }
+    return entry->pair.second;
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual>
+template<class K, class H, class E, class, class>
+const ValueT & PersistentHashMap<KeyT, ValueT, Hash, KeyEqual>::at(const K & key) const
+{
+    const Entry *entry = _lookup(key, _hashOf(key));
+    if (entry == nullptr)
+    {
+        throw (std::invalid_argument(NOT_CONTAIN_ERR));
+    }
+    return entry->pair.second;
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual>
+const ValueT & PersistentHashMap<KeyT, ValueT, Hash, KeyEqual>::operator[](const KeyT & key) const
+{
+    return at(key);
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual>
+typename PersistentHashMap<KeyT, ValueT, Hash, KeyEqual>::const_iterator
+PersistentHashMap<KeyT, ValueT, Hash, KeyEqual>::find(const KeyT & key) const
+{
+    // the path is recorded on the way down, so the iterator can go on from the pair found
+    Iterator found;
+    size_t hash = _hashOf(key);
+    const Node *node = _root.get();
+    for (unsigned int shift = 0; node != nullptr; shift += TRIE_BITS)
+    {
+        if (node->collision)
+        {
+            for (size_t i = 0; i < node->data.size(); i++)
+            {
+                if (node->data[i].hash == hash and _equal(node->data[i].pair.first, key))
+                {
+                    found._push(node, i + 1, 0);
+                    found._current = &node->data[i];
+                    return found;
+                }
+            }
+            return end();
+        }
+        uint32_t bit = _bitOf(hash, shift);
+        if (node->dataMap & bit)
+        {
+            size_t index = _indexOf(node->dataMap, bit);
+            const Entry & entry = node->data[index];
+            if (entry.hash != hash or !_equal(entry.pair.first, key))
+            {
+                return end();
+            }
+            found._push(node, index + 1, 0);
+            found._current = &entry;
+            return found;
+        }
+        if (!(node->nodeMap & bit))
+        {
+            return end();
+        }
+        size_t index = _indexOf(node->nodeMap, bit);
+        found._push(node, node->data.size(), index + 1);
+        node = node->children[index].get();
+    }
+    return end();
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual>
+size_t PersistentHashMap<KeyT, ValueT, Hash, KeyEqual>::size() const
+{
+    return _size;
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual>
+bool PersistentHashMap<KeyT, ValueT, Hash, KeyEqual>::empty() const
+{
+    return _size == 0;
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual>
+bool PersistentHashMap<KeyT, ValueT, Hash, KeyEqual>::operator==(const PersistentHashMap & other) const
+{
+    if (_root == other._root)
+    {
+        return true;
+    }
+    if (_size != other._size)
+    {
+        return false;
+    }
+    if (std::is_empty<Hash>::value)
+    {
+        return _sameNodes(*_root, *other._root);
+    }
+    for (const tuple & pair : other)
+    {
+        const Entry *mine = _lookup(pair.first, _hashOf(pair.first));
+        if (mine == nullptr or !(mine->pair.second == pair.second))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual>
+bool PersistentHashMap<KeyT, ValueT, Hash, KeyEqual>::operator!=(const PersistentHashMap & other) const
+{
+    return !(*this == other);
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual>
+void PersistentHashMap<KeyT, ValueT, Hash, KeyEqual>::swap(PersistentHashMap & other) noexcept
+{
+    std::swap(_root, other._root);
+    std::swap(_size, other._size);
+    std::swap(_hash, other._hash);
+    std::swap(_equal, other._equal);
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual>
+typename PersistentHashMap<KeyT, ValueT, Hash, KeyEqual>::const_iterator
+PersistentHashMap<KeyT, ValueT, Hash, KeyEqual>::begin() const
+{
+    Iterator first;
+    if (_root != nullptr)
+    {
+        first._push(_root.get(), 0, 0);
+        first._advance();
+    }
+    return first;
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual>
+typename PersistentHashMap<KeyT, ValueT, Hash, KeyEqual>::const_iterator
+PersistentHashMap<KeyT, ValueT, Hash, KeyEqual>::end() const
+{
+    return Iterator();
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual>
+typename PersistentHashMap<KeyT, ValueT, Hash, KeyEqual>::const_iterator
+PersistentHashMap<KeyT, ValueT, Hash, KeyEqual>::cbegin() const
+{
+    return begin();
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual>
+typename PersistentHashMap<KeyT, ValueT, Hash, KeyEqual>::const_iterator
+PersistentHashMap<KeyT, ValueT, Hash, KeyEqual>::cend() const
+{
+    return end();
+}
+
+//Private Methods:
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual>
+template<class K>
+const typename PersistentHashMap<KeyT, ValueT, Hash, KeyEqual>::Entry *
+PersistentHashMap<KeyT, ValueT, Hash, KeyEqual>::_lookup(const K & key, size_t hash) const
+{
+    const Node *node = _root.get();
+    for (unsigned int shift = 0; node != nullptr; shift += TRIE_BITS)
+    {
+        if (node->collision)
+        {
+            for (const Entry & entry : node->data)
+            {
+                if (entry.hash == hash and _equal(entry.pair.first, key))
+                {
+                    return &entry;
+                }
+            }
+            return nullptr;
+        }
+        uint32_t bit = _bitOf(hash, shift);
+        if (node->dataMap & bit)
+        {
+            const Entry & entry = node->data[_indexOf(node->dataMap, bit)];
+            return entry.hash == hash and _equal(entry.pair.first, key) ? &entry : nullptr;
+        }
+        node = (node->nodeMap & bit) ? node->children[_indexOf(node->nodeMap, bit)].get() : nullptr;
+    }
+    return nullptr;
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual>
+typename PersistentHashMap<KeyT, ValueT, Hash, KeyEqual>::NodePtr
+PersistentHashMap<KeyT, ValueT, Hash, KeyEqual>::_pairNode(Entry && first, Entry && second, unsigned int shift)
+{
+    NodePtr node = std::make_shared<Node>();
+    if (shift >= TRIE_HASH_BITS)
+    {
+        node->collision = true;
+        node->data.push_back(std::move(first));
+        node->data.push_back(std::move(second));
+        return node;
+    }
+    uint32_t firstBit = _bitOf(first.hash, shift);
+    uint32_t secondBit = _bitOf(second.hash, shift);
+    if (firstBit == secondBit)
+    {
+        node->nodeMap = firstBit;
+        node->children.push_back(_pairNode(std::move(first), std::move(second), shift + TRIE_BITS));
+        return node;
+    }
+    node->dataMap = firstBit | secondBit;
+    node->data.push_back(std::move(firstBit < secondBit ? first : second));
+    node->data.push_back(std::move(firstBit < secondBit ? second : first));
+    return node;
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual>
+typename PersistentHashMap<KeyT, ValueT, Hash, KeyEqual>::NodePtr
+PersistentHashMap<KeyT, ValueT, Hash, KeyEqual>::_insert(const NodePtr & node, Entry && entry, unsigned int shift,
+                                                         bool owned, bool assign, bool & added) const
+{
+    if (node->collision)
+    {
+        for (size_t i = 0; i < node->data.size(); i++)
+        {
+            if (node->data[i].hash == entry.hash and _equal(node->data[i].pair.first, entry.pair.first))
+            {
+                if (!assign)
+                {
+                    return node;
+                }
+                NodePtr edited = _editable(node, owned);
+                edited->data[i].pair.second = std::move(entry.pair.second);
+                return edited;
+            }
+        }
+        NodePtr edited = _editable(node, owned);
+        edited->data.push_back(std::move(entry));
+        added = true;
+        return edited;
+    }
+
+    uint32_t bit = _bitOf(entry.hash, shift);
+    if (node->dataMap & bit)
+    {
+        size_t index = _indexOf(node->dataMap, bit);
+        const Entry & resident = node->data[index];
+        if (resident.hash == entry.hash and _equal(resident.pair.first, entry.pair.first))
+        {
+            if (!assign)
+            {
+                return node;
+            }
+            NodePtr edited = _editable(node, owned);
+            edited->data[index].pair.second = std::move(entry.pair.second);
+            return edited;
+        }
+        // two keys in one slot: the resident moves down into a new child along with the new pair
+        NodePtr edited = _editable(node, owned);
+        Entry moved = std::move(edited->data[index]);
+        edited->data.erase(edited->data.begin() + index);
+        edited->dataMap ^= bit;
+        NodePtr child = _pairNode(std::move(moved), std::move(entry), shift + TRIE_BITS);
+        edited->children.insert(edited->children.begin() + _indexOf(edited->nodeMap, bit), std::move(child));
+        edited->nodeMap |= bit;
+        added = true;
+        return edited;
+    }
+
+    if (node->nodeMap & bit)
+    {
+        size_t index = _indexOf(node->nodeMap, bit);
+        const NodePtr & child = node->children[index];
+        NodePtr updated = _insert(child, std::move(entry), shift + TRIE_BITS, owned and child.use_count() == 1,
+                                  assign, added);
+        if (updated == child)
+        {
+            return node;
+        }
+        NodePtr edited = _editable(node, owned);
+        edited->children[index] = std::move(updated);
+        return edited;
+    }
+
+    NodePtr edited = _editable(node, owned);
+    edited->data.insert(edited->data.begin() + _indexOf(edited->dataMap, bit), std::move(entry));
+    edited->dataMap |= bit;
+    added = true;
+    return edited;
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual>
+typename PersistentHashMap<KeyT, ValueT, Hash, KeyEqual>::NodePtr
+PersistentHashMap<KeyT, ValueT, Hash, KeyEqual>::_erase(const NodePtr & node, const KeyT & key, size_t hash,
+                                                        unsigned int shift) const
+{
+    if (node->collision)
+    {
+        for (size_t i = 0; i < node->data.size(); i++)
+        {
+            if (node->data[i].hash == hash and _equal(node->data[i].pair.first, key))
+            {
+                NodePtr edited = std::make_shared<Node>(*node);
+                edited->data.erase(edited->data.begin() + i);
+                return edited;
+            }
+        }
+        return node;
+    }
+
+    uint32_t bit = _bitOf(hash, shift);
+    if (node->dataMap & bit)
+    {
+        size_t index = _indexOf(node->dataMap, bit);
+        if (node->data[index].hash != hash or !_equal(node->data[index].pair.first, key))
+        {
+            return node;
+        }
+        if (node->nodeMap == 0 and node->data.size() == 1)
+        {
+            return nullptr;
+        }
+        NodePtr edited = std::make_shared<Node>(*node);
+        edited->data.erase(edited->data.begin() + index);
+        edited->dataMap ^= bit;
+        return edited;
+    }
+
+    if (!(node->nodeMap & bit))
+    {
+        return node;
+    }
+    size_t index = _indexOf(node->nodeMap, bit);
+    const NodePtr & child = node->children[index];
+    NodePtr updated = _erase(child, key, hash, shift + TRIE_BITS);
+    if (updated == child)
+    {
+        return node;
+    }
+    NodePtr edited = std::make_shared<Node>(*node);
+    if (updated == nullptr or _isSingleton(*updated))
+    {
+        // a child left with one pair is folded into this node, so the form of the trie depends on its pairs only
+        edited->children.erase(edited->children.begin() + index);
+        edited->nodeMap ^= bit;
+        if (updated != nullptr)
+        {
+            edited->data.insert(edited->data.begin() + _indexOf(edited->dataMap, bit), updated->data.front());
+            edited->dataMap |= bit;
+        }
+    }
+    else
+    {
+        edited->children[index] = std::move(updated);
+    }
+    return edited;
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual>
+PersistentHashMap<KeyT, ValueT, Hash, KeyEqual>
+PersistentHashMap<KeyT, ValueT, Hash, KeyEqual>::_with(const KeyT & key, const ValueT & value, bool assign) const
+{
+    PersistentHashMap version(*this);
+    bool added = false;
+    NodePtr root = _root != nullptr ? _root : std::make_shared<Node>();
+    version._root = _insert(root, Entry{_hashOf(key), tuple(key, value)}, 0, _root == nullptr, assign, added);
+    version._size += added;
+    return version;
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual>
+bool PersistentHashMap<KeyT, ValueT, Hash, KeyEqual>::_sameNodes(const Node & first, const Node & second) const
+{
+    if (&first == &second)
+    {
+        return true;
+    }
+    if (first.collision != second.collision or first.dataMap != second.dataMap or
+        first.nodeMap != second.nodeMap or first.data.size() != second.data.size())
+    {
+        return false;
+    }
+    for (size_t i = 0; i < first.data.size(); i++)
+    {
+        // pairs of other nodes are in the same slots on both sides, those of a collision node are in no order
+        const Entry & entry = first.data[i];
+        bool found = false;
+        for (size_t j = first.collision ? 0 : i; j < second.data.size() and !found; j++)
+        {
+            const Entry & other = second.data[j];
+            found = other.hash == entry.hash and _equal(other.pair.first, entry.pair.first) and
+                    other.pair.second == entry.pair.second;
+            if (!first.collision)
+            {
+                break;
+            }
+        }
+        if (!found)
+        {
+            return false;
+        }
+    }
+    for (size_t i = 0; i < first.children.size(); i++)
+    {
+        if (!_sameNodes(*first.children[i], *second.children[i]))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+#endif
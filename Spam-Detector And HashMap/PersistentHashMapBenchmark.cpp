@@ -0,0 +1,231 @@
+#include <iostream>
+#include <iomanip>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+#include "HashMap.hpp"
+#include "PersistentHashMap.hpp"
+
+static const size_t KEY_COUNTS[] = {10000, 100000, 1000000};
+
+/**
+ * Versions kept of every map, each made from the one before it by EDITS changes
+ */
+static const size_t VERSIONS = 16;
+
+static const size_t EDITS = 8;
+
+static const size_t KEY_LENGTH = 24;
+
+static const size_t LOOKUPS = 2000000;
+
+static const uint64_t RANDOM_SEED = 20240601;
+
+static const char *const FIRST_LETTER = "a";
+
+static const int LETTERS = 26;
+
+static const size_t ALLOCATION_HEADER = alignof(std::max_align_t);
+
+/**
+ * Bytes allocated and not freed yet, by any operator new of the program
+ */
+static std::atomic<size_t> liveBytes(0);
+
+__attribute__((noinline)) void *operator new(size_t bytes)
+{
+    void *block = std::malloc(bytes + ALLOCATION_HEADER);
+    if (block == nullptr)
+    {
+        throw (std::bad_alloc());
+    }
+    *static_cast<size_t *>(block) = bytes;
+    liveBytes += bytes;
+    return static_cast<char *>(block) + ALLOCATION_HEADER;
+}
+
+__attribute__((noinline)) void operator delete(void *pointer) noexcept
+{
+    if (pointer != nullptr)
+    {
+        void *block = static_cast<char *>(pointer) - ALLOCATION_HEADER;
+        liveBytes -= *static_cast<size_t *>(block);
+        std::free(block);
+    }
+}
+
+void operator delete(void *pointer, size_t) noexcept
+{
+    operator delete(pointer);
+}
+
+/**
+ * Builds distinct random lower case keys of KEY_LENGTH, words separated by spaces like SpamDetector phrases
+ */
+std::vector<std::string> makeKeys(size_t count, std::mt19937_64 & generator)
+{
+    std::uniform_int_distribution<int> letter(0, LETTERS);
+    std::vector<std::string> keys(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        std::string & key = keys[i];
+        for (size_t j = 0; j + sizeof(size_t) * 2 < KEY_LENGTH; j++)
+        {
+            int drawn = letter(generator);
+            key.push_back(drawn == LETTERS ? ' ' : static_cast<char>(FIRST_LETTER[0] + drawn));
+        }
+        for (size_t rest = i; key.size() < KEY_LENGTH; rest /= LETTERS)
+        {
+            key.push_back(static_cast<char>(FIRST_LETTER[0] + rest % LETTERS));
+        }
+    }
+    return keys;
+}
+
+/**
+ * @return seconds the given function took
+ */
+template<class Function>
+double seconds(Function function)
+{
+    auto start = std::chrono::steady_clock::now();
+    function();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * @return nanoseconds per lookup of LOOKUPS random present keys in the given map
+ */
+template<class Map>
+double lookups(const Map & map, const std::vector<std::string> & keys, const std::vector<size_t> & order)
+{
+    volatile size_t sink = 0;
+    size_t found = 0;
+    double took = seconds([&]()
+    {
+        for (size_t index : order)
+        {
+            found += map.containsKey(keys[index]);
+        }
+    });
+    sink = sink + found;
+    return took * 1e9 / order.size();
+}
+
+/**
+ * One change of a version: the key at the given index gets a new value, or leaves the map
+ */
+struct Edit
+{
+    size_t index;
+
+    bool erase;
+};
+
+/**
+ * Keeps VERSIONS versions of a map of the given keys, each made from the one before by EDITS changes: a full
+ * HashMap copy (HashMap(const HashMap &)) edited in place, against PersistentHashMap's insert_or_assign and
+ * erase sharing the untouched nodes. Prints the build time and heap bytes per key of the first version, the
+ * time and the heap bytes of every later one, and lookup times.
+ */
+int main()
+{
+    std::mt19937_64 generator(RANDOM_SEED);
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "versions: " << VERSIONS << ", edits per version: " << EDITS << "\n";
+    std::cout << std::setw(10) << "keys" << std::setw(14) << "map" << std::setw(12) << "build (s)"
+              << std::setw(12) << "bytes/key" << std::setw(16) << "us/version" << std::setw(16) << "bytes/version"
+              << std::setw(12) << "lookup ns" << "\n";
+    for (size_t count : KEY_COUNTS)
+    {
+        std::vector<std::string> keys = makeKeys(count, generator);
+        std::uniform_int_distribution<size_t> pick(0, count - 1);
+        std::vector<size_t> order(LOOKUPS);
+        for (size_t & index : order)
+        {
+            index = pick(generator);
+        }
+        std::vector<Edit> edits(VERSIONS * EDITS);
+        for (Edit & edit : edits)
+        {
+            edit = Edit{pick(generator), generator() % 2 == 0};
+        }
+
+        size_t before = liveBytes;
+        std::vector<HashMap<std::string, int>> copies(1);
+        copies.reserve(VERSIONS + 1);
+        double built = seconds([&]()
+        {
+            for (size_t i = 0; i < count; i++)
+            {
+                copies[0].insert(keys[i], static_cast<int>(i));
+            }
+        });
+        size_t base = liveBytes;
+        double copied = seconds([&]()
+        {
+            for (size_t v = 0; v < VERSIONS; v++)
+            {
+                copies.push_back(copies.back());
+                HashMap<std::string, int> & version = copies.back();
+                for (size_t e = v * EDITS; e < (v + 1) * EDITS; e++)
+                {
+                    if (edits[e].erase)
+                    {
+                        version.erase(keys[edits[e].index]);
+                    }
+                    else
+                    {
+                        version[keys[edits[e].index]] = static_cast<int>(v);
+                    }
+                }
+            }
+        });
+        double copyBytes = static_cast<double>(liveBytes - base) / VERSIONS;
+        std::cout << std::setw(10) << count << std::setw(14) << "HashMap copy" << std::setw(12) << built
+                  << std::setw(12) << static_cast<double>(base - before) / count << std::setw(16)
+                  << copied * 1e6 / VERSIONS << std::setw(16) << copyBytes << std::setw(12)
+                  << lookups(copies.back(), keys, order) << "\n";
+        copies.clear();
+        copies.shrink_to_fit();
+
+        before = liveBytes;
+        std::vector<PersistentHashMap<std::string, int>> versions;
+        versions.reserve(VERSIONS + 1);
+        built = seconds([&]()
+        {
+            std::vector<std::pair<std::string, int>> pairs;
+            pairs.reserve(count);
+            for (size_t i = 0; i < count; i++)
+            {
+                pairs.emplace_back(keys[i], static_cast<int>(i));
+            }
+            versions.emplace_back(pairs.begin(), pairs.end());
+        });
+        base = liveBytes;
+        double derived = seconds([&]()
+        {
+            for (size_t v = 0; v < VERSIONS; v++)
+            {
+                PersistentHashMap<std::string, int> version = versions.back();
+                for (size_t e = v * EDITS; e < (v + 1) * EDITS; e++)
+                {
+                    const std::string & key = keys[edits[e].index];
+                    version = edits[e].erase ? version.erase(key)
+                                             : version.insert_or_assign(key, static_cast<int>(v));
+                }
+                versions.push_back(version);
+            }
+        });
+        double sharedBytes = static_cast<double>(liveBytes - base) / VERSIONS;
+        std::cout << std::setw(10) << count << std::setw(14) << "Persistent" << std::setw(12) << built
+                  << std::setw(12) << static_cast<double>(base - before) / count << std::setw(16)
+                  << derived * 1e6 / VERSIONS << std::setw(16) << sharedBytes << std::setw(12)
+                  << lookups(versions.back(), keys, order) << "\n";
+    }
+    return 0;
+}
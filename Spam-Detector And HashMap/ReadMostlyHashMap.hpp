@@ -0,0 +1,318 @@
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "Epoch.hpp"
+#include "HashMap.hpp"
+
+
+#ifndef CPP_EX3_READMOSTLYHASHMAP_HPP
+#define CPP_EX3_READMOSTLYHASHMAP_HPP
+
+template<class KeyT, class ValueT, class Hash = KeyHash<KeyT>, class KeyEqual = std::equal_to<>,
+        class Allocator = std::allocator<std::pair<KeyT, ValueT>>, class Storage = ChainedStorage>
+/**
+ * A hash map for many threads that read it all the time and rarely change it: readers never lock and never
+ * wait. The map is a pointer to an immutable HashMap (a version); a writer builds a new version aside -
+ * copying the current one and editing the copy, re-hashing it as needed - and publishes it with one atomic
+ * store, so a reader sees either the old version or the new one, never a table in the middle of a change.
+ * Old versions are freed once no reader can still be using them (see EpochDomain).
+ * Every write copies the whole map: meant for tables replaced or edited in batches (update, replace),
+ * not for a stream of single writes (see ConcurrentHashMap for those). Writers are serialized by a mutex.
+ * @tparam KeyT - represents a key for the map
+ * @tparam ValueT - represents a value for the map
+ * @tparam Hash - hash function of the keys
+ * @tparam KeyEqual - equality of the keys
+ * @tparam Allocator - allocator of the pairs
+ * @tparam Storage - storage policy of the versions (see HashMap)
+ */
+class ReadMostlyHashMap
+{
+public:
+
+    typedef HashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage> map_type;
+
+    /**
+     * Default Constructor: an empty map
+     */
+    ReadMostlyHashMap();
+
+    /**
+     * Constructs a map whose first version is the given map
+     * @param map - the first version
+     */
+    explicit ReadMostlyHashMap(map_type && map);
+
+    ReadMostlyHashMap(const ReadMostlyHashMap & other) = delete;
+
+    ReadMostlyHashMap & operator=(const ReadMostlyHashMap & other) = delete;
+
+    /**
+     * Destructor, no thread may be reading the map anymore
+     */
+    ~ReadMostlyHashMap();
+
+    /**
+     * Calls the function with the current version of the map, which stays valid until the function returns,
+     * so several lookups see the same version
+     * @param function - called with a const map_type &
+     * @return what the function returns
+     */
+    template<class F>
+    auto read(F && function) const -> decltype(function(std::declval<const map_type &>()));
+
+    /**
+     * Copies the value of the key out of the map
+     * @param key - key value (or any type the hash function accepts)
+     * @param value - set to the value of the key if it is in the map
+     * @return true if the key is in the map
+     */
+    template<class K>
+    bool get(const K & key, ValueT & value) const;
+
+    /**
+     * @return True if the given key contained in the map and false otherwise
+     */
+    template<class K>
+    bool containsKey(const K & key) const;
+
+    /**
+     * @return number of pairs in the current version
+     */
+    size_t size() const;
+
+    /**
+     * Publishes a new version: a copy of the current one edited by the given function
+     * @param edit - called with a map_type & to change, before any reader can see it
+     */
+    template<class F>
+    void update(F && edit);
+
+    /**
+     * Publishes the given map as the new version
+     * @param map - the new version
+     */
+    void replace(map_type && map);
+
+    /**
+     * Publishes a new version where the key is mapped to the given value
+     * @param key - key value
+     * @param value - the new value of the key
+     */
+    template<class M>
+    void insert_or_assign(const KeyT & key, M && value);
+
+    /**
+     * Publishes a new version without the key, if the key is in the map
+     * @param key - key value
+     * @return true if the pair has been removed and false otherwise
+     */
+    bool erase(const KeyT & key);
+
+    /**
+     * Waits until every old version has been freed, that is until the readers that started before the
+     * last write are done
+     */
+    void synchronize();
+
+    /**
+     * @return number of old versions that some reader may still be using
+     */
+    size_t retiredVersions() const;
+
+private:
+
+    /**
+     * An old version and the epoch from which it can be freed
+     */
+    struct Retired
+    {
+        const map_type *version;
+
+        uint64_t epoch;
+    };
+
+    std::atomic<const map_type *> _current;
+
+    mutable std::mutex _writeMutex;
+
+    std::vector<Retired> _retired;
+
+    /**
+     * Makes the given map the current version and retires the previous one, the write lock must be held
+     * @param version - the new version
+     */
+    void _publish(std::unique_ptr<const map_type> version);
+
+    /**
+     * Frees the retired versions no reader can be using anymore, the write lock must be held
+     */
+    void _reclaim();
+};
+
+//=================ReadMostlyHashMap implementation==================//
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+ReadMostlyHashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::ReadMostlyHashMap() :
+        _current(new map_type())
+{
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+ReadMostlyHashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::ReadMostlyHashMap(map_type && map) :
+        _current(new map_type(std::move(map)))
+{
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+ReadMostlyHashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::~ReadMostlyHashMap()
+{
+    for (const Retired & retired : _retired)
+    {
+        delete retired.version;
+    }
+    delete _current.load();
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+template<class F>
+auto ReadMostlyHashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::read(F && function) const
+-> decltype(function(std::declval<const map_type &>()))
+{
+    EpochGuard guard;
+    return function(*_current.load());
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+template<class K>
+bool ReadMostlyHashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::get(const K & key, ValueT & value) const
+{
+    return read([&key, &value](const map_type & map)
+    {
+        auto found = map.find(key);
+        if (found == map.end())
+        {
+            return false;
+        }
+        value = found->second;
+        return true;
+    });
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+template<class K>
+bool ReadMostlyHashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::containsKey(const K & key) const
+{
+    return read([&key](const map_type & map)
+    {
+        return map.containsKey(key);
+    });
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+size_t ReadMostlyHashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::size() const
+{
+    return read([](const map_type & map)
+    {
+        return map.size();
+    });
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+template<class F>
+void ReadMostlyHashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::update(F && edit)
+{
+    std::lock_guard<std::mutex> lock(_writeMutex);
+    std::unique_ptr<map_type> version(new map_type(*_current.load()));
+    edit(*version);
+    _publish(std::move(version));
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+void ReadMostlyHashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::replace(map_type && map)
+{
+    std::unique_ptr<const map_type> version(new map_type(std::move(map)));
+    std::lock_guard<std::mutex> lock(_writeMutex);
+    _publish(std::move(version));
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+template<class M>
+void ReadMostlyHashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::insert_or_assign(const KeyT & key,
+                                                                                           M && value)
+{
+    update([&key, &value](map_type & map)
+    {
+        map.insert_or_assign(key, std::forward<M>(value));
+    });
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+bool ReadMostlyHashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::erase(const KeyT & key)
+{
+    if (!containsKey(key))
+    {
+        return false;
+    }
+    bool erased = false;
+    update([&key, &erased](map_type & map)
+    {
+        erased = map.erase(key);
+    });
+    return erased;
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+void ReadMostlyHashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::synchronize()
+{
+    std::unique_lock<std::mutex> lock(_writeMutex);
+    _reclaim();
+    while (!_retired.empty())
+    {
+        lock.unlock();
+        std::this_thread::yield();
+        lock.lock();
+        _reclaim();
+    }
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+size_t ReadMostlyHashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::retiredVersions() const
+{
+    std::lock_guard<std::mutex> lock(_writeMutex);
+    return _retired.size();
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+void ReadMostlyHashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::_publish(
+        std::unique_ptr<const map_type> version)
+{
+    _retired.reserve(_retired.size() + 1);
+    const map_type *old = _current.exchange(version.release());
+    _retired.push_back({old, EpochDomain::instance().advance()});
+    _reclaim();
+}
+
+template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator, class Storage>
+void ReadMostlyHashMap<KeyT, ValueT, Hash, KeyEqual, Allocator, Storage>::_reclaim()
+{
+    EpochDomain & domain = EpochDomain::instance();
+    size_t kept = 0;
+    for (const Retired & retired : _retired)
+    {
+        if (domain.isSafe(retired.epoch))
+        {
+            delete retired.version;
+        }
+        else
+        {
+            _retired[kept++] = retired;
+        }
+    }
+    _retired.resize(kept);
+}
+
+#endif
@@ -0,0 +1,216 @@
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <string>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <vector>
+#include "ReadMostlyHashMap.hpp"
+#include "ConcurrentHashMap.hpp"
+
+static const size_t READER_THREADS = 4;
+
+static const size_t READS_PER_THREAD = 500000;
+
+static const size_t SMALL_VERSION = 1000;
+
+static const size_t LARGE_VERSION = 100000;
+
+static const size_t GENERATION_KEY = 0;
+
+static const uint64_t RANDOM_SEED = 20240601;
+
+static const size_t HISTOGRAM_BUCKETS = 40;
+
+static const double PERCENTILES[] = {0.5, 0.9, 0.99, 0.999, 0.9999};
+
+/**
+ * Read latencies, bucket i counts the reads that took [2^i, 2^(i+1)) nanoseconds
+ */
+struct Histogram
+{
+    size_t counts[HISTOGRAM_BUCKETS] = {};
+
+    size_t total = 0;
+
+    void add(uint64_t nanos)
+    {
+        size_t bucket = 0;
+        while (bucket + 1 < HISTOGRAM_BUCKETS and (nanos >> (bucket + 1)) != 0)
+        {
+            bucket++;
+        }
+        counts[bucket]++;
+        total++;
+    }
+
+    void merge(const Histogram & other)
+    {
+        for (size_t i = 0; i < HISTOGRAM_BUCKETS; i++)
+        {
+            counts[i] += other.counts[i];
+        }
+        total += other.total;
+    }
+
+    /**
+     * @return the upper bound in nanoseconds of the bucket the given fraction of the reads falls in
+     */
+    uint64_t percentile(double fraction) const
+    {
+        size_t seen = 0;
+        for (size_t i = 0; i < HISTOGRAM_BUCKETS; i++)
+        {
+            seen += counts[i];
+            if (seen >= fraction * total)
+            {
+                return uint64_t(1) << (i + 1);
+            }
+        }
+        return uint64_t(1) << HISTOGRAM_BUCKETS;
+    }
+
+    void print(const std::string & name) const
+    {
+        std::cout << name << "\n";
+        for (double fraction : PERCENTILES)
+        {
+            std::cout << "  p" << std::setw(7) << std::left << fraction * 100 << std::right << " < "
+                      << percentile(fraction) << " ns\n";
+        }
+        for (size_t i = 0; i < HISTOGRAM_BUCKETS; i++)
+        {
+            if (counts[i] != 0)
+            {
+                std::cout << "  [" << std::setw(10) << (uint64_t(1) << i) << ", " << std::setw(10)
+                          << (uint64_t(1) << (i + 1)) << ") ns " << std::setw(10) << counts[i] << "\n";
+            }
+        }
+    }
+};
+
+/**
+ * @return a map where the keys 0..size-1 are all mapped to the given generation
+ */
+HashMap<size_t, size_t> makeVersion(size_t size, size_t generation)
+{
+    HashMap<size_t, size_t> version;
+    for (size_t key = 0; key < size; key++)
+    {
+        version.insert_or_assign(key, generation);
+    }
+    return version;
+}
+
+/**
+ * Runs READER_THREADS readers that time every read while the writer keeps changing the map,
+ * until all the readers are done
+ * @param read - reads one key, called as read(key), returns false if the read saw a broken map
+ * @param write - makes one change to the map, called as write(generation)
+ * @param histogram - the read latencies
+ * @return false if any read saw a broken map
+ */
+template<class Read, class Write>
+bool runReaders(Read read, Write write, Histogram & histogram)
+{
+    std::atomic<size_t> running(READER_THREADS);
+    std::atomic<bool> broken(false);
+    std::vector<Histogram> histograms(READER_THREADS);
+    std::vector<std::thread> readers;
+    for (size_t t = 0; t < READER_THREADS; t++)
+    {
+        readers.emplace_back([&, t]()
+        {
+            std::mt19937_64 generator(RANDOM_SEED + t);
+            std::uniform_int_distribution<size_t> keys(0, LARGE_VERSION - 1);
+            for (size_t i = 0; i < READS_PER_THREAD; i++)
+            {
+                size_t key = keys(generator);
+                auto start = std::chrono::steady_clock::now();
+                bool valid = read(key);
+                auto stop = std::chrono::steady_clock::now();
+                histograms[t].add(static_cast<uint64_t>(
+                                          std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count()));
+                if (!valid)
+                {
+                    broken = true;
+                }
+            }
+            running--;
+        });
+    }
+    for (size_t generation = 1; running != 0; generation++)
+    {
+        write(generation);
+    }
+    for (std::thread & reader : readers)
+    {
+        reader.join();
+    }
+    for (const Histogram & partial : histograms)
+    {
+        histogram.merge(partial);
+    }
+    return !broken;
+}
+
+/**
+ * Stress test and latency benchmark of ReadMostlyHashMap: readers run while a writer keeps publishing
+ * versions that alternate between SMALL_VERSION and LARGE_VERSION keys (so every version is re-hashed).
+ * Every value of a version is its generation, a reader checks within one read that the key it looks up has
+ * the generation of the version it sees - any mix of two versions or any freed version would break it.
+ * The latencies are compared with the reads of a ConcurrentHashMap (shared locks) under the same writes.
+ */
+int main()
+{
+    ReadMostlyHashMap<size_t, size_t> readMostly(makeVersion(LARGE_VERSION, 0));
+    Histogram lockFree;
+    size_t versions = 0;
+    bool valid = runReaders([&readMostly](size_t key)
+                            {
+                                return readMostly.read([key](const HashMap<size_t, size_t> & map)
+                                                       {
+                                                           size_t generation = map.at(GENERATION_KEY);
+                                                           auto found = map.find(key);
+                                                           return found == map.end() or
+                                                                  found->second == generation;
+                                                       });
+                            }, [&readMostly, &versions](size_t generation)
+                            {
+                                size_t size = generation % 2 == 0 ? LARGE_VERSION : SMALL_VERSION;
+                                readMostly.replace(makeVersion(size, generation));
+                                versions++;
+                            }, lockFree);
+    readMostly.synchronize();
+    if (!valid or readMostly.retiredVersions() != 0)
+    {
+        std::cout << "ReadMostlyHashMap: a reader saw a broken version\n";
+        return EXIT_FAILURE;
+    }
+    std::cout << "ReadMostlyHashMap: " << versions << " versions published during the reads, all reads valid\n";
+
+    ConcurrentHashMap<size_t, size_t> sharded;
+    for (size_t key = 0; key < LARGE_VERSION; key++)
+    {
+        sharded.insert_or_assign(key, 0);
+    }
+    Histogram locked;
+    runReaders([&sharded](size_t key)
+               {
+                   size_t value;
+                   sharded.get(key, value);
+                   return true;
+               }, [&sharded](size_t generation)
+               {
+                   for (size_t key = 0; key < SMALL_VERSION; key++)
+                   {
+                       sharded.insert_or_assign(key, generation);
+                   }
+               }, locked);
+
+    lockFree.print("ReadMostlyHashMap read latency");
+    locked.print("ConcurrentHashMap read latency");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,540 @@
+#include <utility>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "KeyHash.hpp"
+#include "HashMapStats.hpp"
+#include <new>
+
+
+#ifndef CPP_EX3_ROBINHOODTABLE_HPP
+#define CPP_EX3_ROBINHOODTABLE_HPP
+
+static const unsigned int EMPTY_SLOT = 0;
+
+template<class KeyT, class ValueT, class Hash = KeyHash<KeyT>, class KeyEqual = std::equal_to<>,
+        class Allocator = std::allocator<std::pair<KeyT, ValueT>>, bool CacheHash = CacheHashCode<KeyT>::value>
+/**
+ * Open addressing storage for HashMap: all the (key,value) pairs live in one contiguous array of slots.
+ * Collisions are resolved with linear probing and Robin Hood displacement (a pair that is further from its
+ * home slot takes the place of a pair that is closer to its own), erase uses backward-shift deletion so
+ * no tombstones are ever left behind.
+ * With CacheHash every slot keeps the hash code of its key, which is compared before the key on lookups and
+ * reused by re-hashing, so re-hashing never hashes a key again.
+ * The table never resizes itself, the owning map decides when and to which capacity to re-hash.
+ * @tparam KeyT - represents a key for the map
+ * @tparam ValueT - represents a value for the map
+ * @tparam Hash - hash function of the keys
+ * @tparam KeyEqual - equality of the keys
+ * @tparam Allocator - allocator of the map, rebound to the table's own node types
+ * @tparam CacheHash - whether every pair keeps the hash code of its key (see CacheHashCode)
+ */
+class RobinHoodTable
+{
+public:
+
+    using tuple = std::pair<KeyT, ValueT>;
+
+    /**
+     * Location of a pair within the table: its slot (item is always 0)
+     */
+    struct Position
+    {
+        size_t bucket;
+
+        size_t item;
+
+        bool operator==(const Position & other) const
+        {
+            return bucket == other.bucket and item == other.item;
+        }
+    };
+
+    /**
+     * Constructs a table with the given number of slots
+     * @param capacity - number of slots, must be a power of two (see validCapacity)
+     * @param hash - hash function of the keys
+     * @param equal - equality of the keys
+     * @param allocator - allocator of the slots array
+     * @param deferSlots - DEFER_SLOTS to allocate the slots without marking them empty (see initializeSlots)
+     */
+    explicit RobinHoodTable(size_t capacity = 0, const Hash & hash = Hash(), const KeyEqual & equal = KeyEqual(),
+                            const Allocator & allocator = Allocator(), bool deferSlots = false) :
+            _capacity(capacity), _slots(nullptr), _hash(hash), _equal(equal), _slotAllocator(allocator)
+    {
+        if (_capacity != 0)
+        {
+            _slots = _slotAllocator.allocate(_capacity);
+            if (!deferSlots)
+            {
+                initializeSlots(0, _capacity);
+            }
+        }
+    }
+
+    RobinHoodTable(const RobinHoodTable & other) = delete;
+
+    RobinHoodTable & operator=(const RobinHoodTable & other) = delete;
+
+    /**
+     * Destructor
+     */
+    ~RobinHoodTable()
+    {
+        if (_slots != nullptr)
+        {
+            clear();
+            _slotAllocator.deallocate(_slots, _capacity);
+        }
+    }
+
+    /**
+     * Marks the slots in the given range of a table constructed with DEFER_SLOTS empty; every slot must be
+     * marked once before the table is used
+     * @param first - first slot to mark
+     * @param last - one past the last slot to mark
+     */
+    void initializeSlots(size_t first, size_t last)
+    {
+        for (size_t i = first; i < last; i++)
+        {
+            _slots[i].distance = EMPTY_SLOT;
+        }
+    }
+
+    /**
+     * Frees the slots without visiting them, leaving a table with no slots. Only for a table holding no pair:
+     * one emptied slot by slot by takeBucket, or one whose slots were never marked.
+     */
+    void releaseEmpty()
+    {
+        if (_slots != nullptr)
+        {
+            _slotAllocator.deallocate(_slots, _capacity);
+            _slots = nullptr;
+        }
+        _capacity = 0;
+    }
+
+    /**
+     * @param requested - the capacity the map asked for
+     * @return the nearest capacity this table can be built with (a power of two, at least 1)
+     */
+    static size_t validCapacity(size_t requested)
+    {
+        size_t capacity = 1;
+        while (capacity < requested)
+        {
+            capacity <<= 1;
+        }
+        return capacity;
+    }
+
+    /**
+     * @return the number of slots
+     */
+    size_t capacity() const
+    {
+        return _capacity;
+    }
+
+    /**
+     * @return the hash function of the table
+     */
+    const Hash & hashFunction() const
+    {
+        return _hash;
+    }
+
+    /**
+     * @return the key equality of the table
+     */
+    const KeyEqual & keyEqual() const
+    {
+        return _equal;
+    }
+
+    /**
+     * @return the allocator of the table
+     */
+    Allocator allocator() const
+    {
+        return Allocator(_slotAllocator);
+    }
+
+    /**
+     * @return number of slots left behind by erase, always 0 as erase never leaves tombstones
+     */
+    size_t tombstones() const
+    {
+        return 0;
+    }
+
+    /**
+     * @param key - key value, or a value of any type the (transparent) hash function accepts
+     * @return the (mixed, see mixHash) hash code of the key, computed once per operation and passed to the
+     * other methods
+     */
+    template<class K>
+    size_t hashOf(const K & key) const
+    {
+        return mixHash(_hash(key));
+    }
+
+    /**
+     * @param hash - hash code of a key
+     * @return the home slot of the key (the slot probing starts from)
+     */
+    size_t bucketIndex(size_t hash) const
+    {
+        return _clamp(hash);
+    }
+
+    /**
+     * Starts loading the home slot of the given hash code (and the pair stored in it) into the cache,
+     * for a find that follows
+     * @param hash - hash code of a key
+     */
+    void prefetch(size_t hash) const
+    {
+        prefetchAddress(&_slots[bucketIndex(hash)]);
+    }
+
+    /**
+     * @param key - key value, or a value of any type the (transparent) hash function accepts
+     * @param hash - hash code of the key
+     * @return position of the pair holding the key, end() if the key is not in the table
+     */
+    template<class K>
+    Position find(const K & key, size_t hash) const
+    {
+        size_t index = bucketIndex(hash);
+
+        // once we pass a pair that is closer to its home than we are to ours, the key can not be further
+        for (unsigned int distance = 1; _slots[index].distance >= distance; distance++)
+        {
+            if (_slots[index].hashMatches(hash) and _equal(_pairAt(index)->first, key))
+            {
+                return {index, 0};
+            }
+            index = _clamp(index + 1);
+        }
+        return end();
+    }
+
+    /**
+     * Adds a pair whose key is known not to be in the table, the table must have a free slot
+     * @param pair - (key,value) to add
+     * @param hash - hash code of the key
+     * @return position of the stored pair
+     */
+    Position insertNew(tuple && pair, size_t hash)
+    {
+        size_t index = bucketIndex(hash);
+        unsigned int distance = 1;
+        size_t placed = _capacity;
+
+        while (_slots[index].distance != EMPTY_SLOT)
+        {
+            if (_slots[index].distance < distance)
+            {
+                // the resident is closer to its home than we are: take its slot and carry it on
+                std::swap(pair, *_pairAt(index));
+                _slots[index].swapHash(hash);
+                std::swap(distance, _slots[index].distance);
+                if (placed == _capacity)
+                {
+                    placed = index;
+                }
+            }
+            index = _clamp(index + 1);
+            distance++;
+        }
+        new(_slots[index].storage) tuple(std::move(pair));
+        _slots[index].storeHash(hash);
+        _slots[index].distance = distance;
+        return {placed == _capacity ? index : placed, 0};
+    }
+
+    /**
+     * Moves every pair of the given table into this one (re-hashing), using the stored hash codes (if kept)
+     * instead of hashing the keys again; the pairs are moved and never compared, as they are known to be distinct.
+     * @param source - table to empty
+     */
+    void takeAll(RobinHoodTable & source)
+    {
+        for (size_t i = 0; i < source._capacity; i++)
+        {
+            if (source._slots[i].distance != EMPTY_SLOT)
+            {
+                insertNew(std::move(*source._pairAt(i)), source._hashAt(i));
+                source._pairAt(i)->~tuple();
+                source._slots[i].distance = EMPTY_SLOT;
+            }
+        }
+    }
+
+    /**
+     * Moves the pair of one slot of the given table into this one (one step of an incremental re-hash),
+     * along with the pairs backward-shift pulls into that slot
+     * @param source - table to move the pairs from
+     * @param index - the slot in the source table
+     * @return number of pairs moved
+     */
+    size_t takeBucket(RobinHoodTable & source, size_t index)
+    {
+        size_t moved = 0;
+        while (source._slots[index].distance != EMPTY_SLOT)
+        {
+            takeFrom(source, {index, 0});
+            moved++;
+        }
+        return moved;
+    }
+
+    /**
+     * Moves one pair of the given table into this one, erasing it from the source
+     * @param source - table to move the pair from
+     * @param position - position of the pair in the source table
+     * @return position of the pair in this table
+     */
+    Position takeFrom(RobinHoodTable & source, const Position & position)
+    {
+        Position placed = insertNew(std::move(*source._pairAt(position.bucket)), source._hashAt(position.bucket));
+        source.erase(position);
+        return placed;
+    }
+
+    /**
+     * Copies every pair of the given table into this one, which must be empty and of the same capacity, slot by slot:
+     * the layout is cloned as it is, so no key is hashed, compared or probed for
+     * @param source - table to copy
+     */
+    void cloneFrom(const RobinHoodTable & source)
+    {
+        for (size_t i = 0; i < _capacity; i++)
+        {
+            if (source._slots[i].distance != EMPTY_SLOT)
+            {
+                new(_slots[i].storage) tuple(*source._pairAt(i));
+                _slots[i].copyHash(source._slots[i]);
+                _slots[i].distance = source._slots[i].distance;
+            }
+        }
+    }
+
+    /**
+     * Removes the pair in the given position (which must not be end())
+     */
+    void erase(const Position & position)
+    {
+        size_t index = position.bucket;
+        _pairAt(index)->~tuple();
+        _slots[index].distance = EMPTY_SLOT;
+
+        // backward shift: pull the rest of the cluster one slot towards its home
+        size_t next = _clamp(index + 1);
+        while (_slots[next].distance > 1)
+        {
+            new(_slots[index].storage) tuple(std::move(*_pairAt(next)));
+            _slots[index].copyHash(_slots[next]);
+            _slots[index].distance = _slots[next].distance - 1;
+            _pairAt(next)->~tuple();
+            _slots[next].distance = EMPTY_SLOT;
+            index = next;
+            next = _clamp(next + 1);
+        }
+    }
+
+    /**
+     * Removes all the pairs, keeping the capacity
+     */
+    void clear()
+    {
+        for (size_t i = 0; i < _capacity; i++)
+        {
+            if (_slots[i].distance != EMPTY_SLOT)
+            {
+                _pairAt(i)->~tuple();
+                _slots[i].distance = EMPTY_SLOT;
+            }
+        }
+    }
+
+    /**
+     * @return bytes allocated by the table: the array of slots
+     */
+    size_t allocatedBytes() const
+    {
+        return _capacity * sizeof(Slot);
+    }
+
+    /**
+     * Counts every pair in a probe length histogram (see HashMapStats): a pair is found at the probe of its
+     * distance from its home slot
+     * @param histogram - the histogram to add to
+     */
+    void probeLengths(std::vector<size_t> & histogram) const
+    {
+        for (size_t i = 0; i < _capacity; i++)
+        {
+            if (_slots[i].distance != EMPTY_SLOT)
+            {
+                countProbeLength(histogram, _slots[i].distance);
+            }
+        }
+    }
+
+    /**
+     * @param hash - hash code of a key
+     * @return number of pairs that share the home slot of the key
+     */
+    size_t bucketSize(size_t hash) const
+    {
+        size_t home = bucketIndex(hash);
+        size_t count = 0;
+
+        // pairs are ordered by their home slot along a cluster, so the ones sharing ours are adjacent
+        for (unsigned int offset = 1; _slots[_clamp(home + offset - 1)].distance >= offset; offset++)
+        {
+            if (_slots[_clamp(home + offset - 1)].distance == offset)
+            {
+                count++;
+            }
+        }
+        return count;
+    }
+
+    /**
+     * @return position of the first pair in the table or end() if the table is empty
+     */
+    Position begin() const
+    {
+        Position position = {0, 0};
+        _skipEmpty(position);
+        return position;
+    }
+
+    /**
+     * @return the position past the last pair, the same for every table and every capacity
+     */
+    Position end() const
+    {
+        return {END_BUCKET, 0};
+    }
+
+    /**
+     * Moves the given position to the next pair in the table (or to end())
+     */
+    void advance(Position & position) const
+    {
+        position.bucket++;
+        _skipEmpty(position);
+    }
+
+    /**
+     * @return the pair in the given position (which must not be end())
+     */
+    tuple & at(const Position & position) const
+    {
+        return *_pairAt(position.bucket);
+    }
+
+    /**
+     * @return the hash code of the key of the pair in the given position (which must not be end()), without
+     * hashing the key when the table keeps hash codes
+     */
+    size_t hashAt(const Position & position) const
+    {
+        return _hashAt(position.bucket);
+    }
+
+    /**
+     * This exchanges the contents of two tables
+     */
+    void swap(RobinHoodTable & other) noexcept
+    {
+        std::swap(_capacity, other._capacity);
+        std::swap(_slots, other._slots);
+        std::swap(_hash, other._hash);
+        std::swap(_equal, other._equal);
+        std::swap(_slotAllocator, other._slotAllocator);
+    }
+
+private:
+
+    /**
+     * A slot of the table: the hash code of its key (if kept), the probe distance of its pair from the pair's
+     * home slot plus one (EMPTY_SLOT if the slot is free) and raw storage for the pair itself
+     */
+    struct Slot : StoredHash<CacheHash>
+    {
+        unsigned int distance;
+
+        alignas(tuple) unsigned char storage[sizeof(tuple)];
+    };
+
+    size_t _capacity;
+
+    Slot *_slots;
+
+    Hash _hash;
+
+    KeyEqual _equal;
+
+    typename std::allocator_traits<Allocator>::template rebind_alloc<Slot> _slotAllocator;
+
+    /**
+     * Clamps hashing indices to fit within the current table capacity
+     *
+     * @param index - the index before clamping
+     * @return An index properly clamped
+     */
+    size_t _clamp(size_t index) const
+    {
+        return index & (_capacity - 1);
+    }
+
+    /**
+     * @return the pair stored in the given (occupied) slot
+     */
+    tuple *_pairAt(size_t index) const
+    {
+        return std::launder(reinterpret_cast<tuple *>(_slots[index].storage));
+    }
+
+    /**
+     * @return the hash code of the key of the pair in the given (occupied) slot
+     */
+    size_t _hashAt(size_t index) const
+    {
+        return _slots[index].storedHash(_hash, _pairAt(index)->first);
+    }
+
+    /**
+     * Moves the given position forward until it points to a pair or to end()
+     */
+    void _skipEmpty(Position & position) const
+    {
+        while (position.bucket < _capacity and _slots[position.bucket].distance == EMPTY_SLOT)
+        {
+            position.bucket++;
+        }
+        if (position.bucket == _capacity)
+        {
+            position = end();
+        }
+    }
+};
+
+/**
+ * Storage policy of HashMap: open addressing with Robin Hood probing
+ */
+struct RobinHoodStorage
+{
+    template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator>
+    using table = RobinHoodTable<KeyT, ValueT, Hash, KeyEqual, Allocator, CacheHashCode<KeyT>::value>;
+};
+
+#endif
@@ -3,6 +3,7 @@
 #include <vector>
 #include <fstream>
 #include "HashMap.hpp"
+#include "FrozenHashMap.hpp"
 
 static const char SEPARATOR = ',';
 
@@ -18,9 +19,22 @@ static const char *const NOT_SPAM_MSG = "NOT_SPAM\n";
 
 static const int MIN_THRESHOLD = 1;
 
+static const char *const FREEZE_FLAG = "--freeze";
+
 
 static const char *const BAD_ALLOC_MSG = "Memory allocation failed\n";
 
+/**
+ * The map holding pairs of (bad sequence, score), built once: the sequences and the table live in an arena.
+ * checkSpam walks every pair, so the pairs are kept packed (DenseStorage) and the walk is a sequential scan.
+ */
+typedef ArenaHashMap<int, DenseStorage> ScoreMap;
+
+/**
+ * The same map read straight from a database file frozen with --freeze
+ */
+typedef FrozenHashMap<int> FrozenScoreMap;
+
 /**
  *This method is given an error message and prints it to cerr
  * @param msg - Error message
@@ -130,7 +144,8 @@ bool splitDataLine(std::string & date, std::string & text, int & score)
  * @param secScorePair - pair of (bad sequence, score)
  * @param totalScore -current score of bad sequence
  */
-void updateScore(const std::string & textToCheck, const std::pair<std::string, int> & secScorePair, int & totalScore)
+void updateScore(const std::string & textToCheck, const std::pair<std::string_view, int> & secScorePair,
+                 int & totalScore)
 {
 
     if (textToCheck.find(secScorePair.first) != std::string::npos)
@@ -146,7 +161,8 @@ void updateScore(const std::string & textToCheck, const std::pair<std::string, i
  * @param threshold -  score spam threshold
  * @param text - stream to the file to analyze
  */
-void checkSpam(HashMap<std::string, int> & hashMap, int threshold, std::ifstream & text)
+template<class Map>
+void checkSpam(const Map & hashMap, int threshold, std::ifstream & text)
 {
     std::string line, textToCheck;
     int currTotalScore = 0;
@@ -171,11 +187,12 @@ void checkSpam(HashMap<std::string, int> & hashMap, int threshold, std::ifstream
  *This method initialize a given hash map with pairs of (bad sequence, score) by reading from CV format
  * text file
  * @param hashMap - hash map to initialize
+ * @param arena - the arena of the map, the bad sequences are copied into it
  * @param database - file stream
  * @param score -current score of bad sequence
  * @return true if succeed to initialize the given hash map and false otherwise
  */
-bool initializeMap(HashMap<std::string, int> & hashMap, std::ifstream & database, int & score)
+bool initializeMap(ScoreMap & hashMap, MonotonicArena & arena, std::ifstream & database, int & score)
 {
     std::string data, badSec;
 
@@ -185,14 +202,41 @@ bool initializeMap(HashMap<std::string, int> & hashMap, std::ifstream & database
         {
             return false;
         }
-        hashMap.insert(badSec, score);
+        if (!hashMap.containsKey(badSec))
+        {
+            hashMap.insert(arena.store(badSec), score);
+        }
     }
     return true;
 }
 
 /**
- *Main of the program: given database in CV format which contains bad sequences and there scores,
- *a plain text to analyze and to determine whether the text is spam or not according to the given database
+ *This method reads a database in CV format and writes it as a frozen database, which SpamDetector maps
+ * into memory instead of parsing it
+ * @param databasePath - path of the database in CV format
+ * @param frozenPath - path of the frozen database to write
+ * @return true if succeed to freeze the database and false otherwise
+ */
+bool freezeDatabase(const char *databasePath, const char *frozenPath)
+{
+    MonotonicArena arena;
+    ScoreMap hashMap(arena);
+    std::ifstream database(databasePath);
+    int score;
+
+    if (!database.is_open() or !initializeMap(hashMap, arena, database, score))
+    {
+        return false;
+    }
+    freeze(hashMap, frozenPath);
+    return true;
+}
+
+/**
+ *Main of the program: given database in CV format (or frozen with --freeze) which contains bad sequences
+ * and there scores, a plain text to analyze and to determine whether the text is spam or not according to
+ * the given database. With --freeze as the first argument, freezes the database given second into the
+ * file given third.
  * @param argc- number of arguments
  * @param argv - database, text to analyze and threshold
  */
@@ -206,13 +250,37 @@ int main(int argc, char *argv[])
 
     try
     {
-        HashMap<std::string, int> hashMap;
-        std::ifstream database(argv[1]), text(argv[2]);
+        if (std::string(argv[1]) == FREEZE_FLAG)
+        {
+            if (!freezeDatabase(argv[2], argv[3]))
+            {
+                printErrorMsg(INVALID_MSG);
+                return EXIT_FAILURE;
+            }
+            return EXIT_SUCCESS;
+        }
+
+        std::ifstream text(argv[2]);
         int threshold = std::stoi(argv[3]);
+        if (FrozenScoreMap::isFrozen(argv[1]))
+        {
+            FrozenScoreMap hashMap(argv[1]);
+            if (!text.is_open() or threshold < MIN_THRESHOLD)
+            {
+                printErrorMsg(INVALID_MSG);
+                return EXIT_FAILURE;
+            }
+            checkSpam(hashMap, threshold, text);
+            return EXIT_SUCCESS;
+        }
+
+        MonotonicArena arena;
+        ScoreMap hashMap(arena);
+        std::ifstream database(argv[1]);
         int score;
         bool areFileOpen = database.is_open() and text.is_open();
 
-        if (!areFileOpen or threshold < MIN_THRESHOLD or !initializeMap(hashMap, database, score))
+        if (!areFileOpen or threshold < MIN_THRESHOLD or !initializeMap(hashMap, arena, database, score))
         {
             printErrorMsg(INVALID_MSG);
             return EXIT_FAILURE;
@@ -231,5 +299,11 @@ int main(int argc, char *argv[])
         printErrorMsg(BAD_ALLOC_MSG);
         return EXIT_FAILURE;
     }
+
+    catch (const std::runtime_error & e)
+    {
+        printErrorMsg(INVALID_MSG);
+        return EXIT_FAILURE;
+    }
     return EXIT_SUCCESS;
 }
\ No newline at end of file
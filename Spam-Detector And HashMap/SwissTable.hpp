@@ -0,0 +1,659 @@
+#include <utility>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "KeyHash.hpp"
+#include "HashMapStats.hpp"
+#include <new>
+
+#ifdef __SSE2__
+
+#include <emmintrin.h>
+
+#endif
+
+
+#ifndef CPP_EX3_SWISSTABLE_HPP
+#define CPP_EX3_SWISSTABLE_HPP
+
+static const size_t GROUP_WIDTH = 16;
+
+static const signed char CTRL_EMPTY = -128;
+
+static const signed char CTRL_DELETED = -2;
+
+static const size_t FINGERPRINT_BITS = 7;
+
+static const size_t FINGERPRINT_MASK = 0x7F;
+
+template<class KeyT, class ValueT, class Hash = KeyHash<KeyT>, class KeyEqual = std::equal_to<>,
+        class Allocator = std::allocator<std::pair<KeyT, ValueT>>, bool CacheHash = CacheHashCode<KeyT>::value>
+/**
+ * Open addressing storage for HashMap in the style of a "Swiss table": next to the slots array the table
+ * keeps one control byte per slot, which is either EMPTY, DELETED or the low 7 bits of the hash code of the
+ * pair stored in the slot (its fingerprint).
+ * The slots are split into groups of GROUP_WIDTH, a probe compares the fingerprint against a whole group of
+ * control bytes at once (with SSE2 when available) and compares full keys only on fingerprint matches, so a
+ * lookup of a missing key almost never compares keys at all.
+ * With CacheHash every slot also keeps the full hash code of its key, which is compared before the key on
+ * fingerprint matches and reused by re-hashing, so re-hashing never hashes a key again.
+ * The table never resizes itself, the owning map decides when and to which capacity to re-hash.
+ * @tparam KeyT - represents a key for the map
+ * @tparam ValueT - represents a value for the map
+ * @tparam Hash - hash function of the keys
+ * @tparam KeyEqual - equality of the keys
+ * @tparam Allocator - allocator of the map, rebound to the table's own node types
+ * @tparam CacheHash - whether every pair keeps the hash code of its key (see CacheHashCode)
+ */
+class SwissTable
+{
+public:
+
+    using tuple = std::pair<KeyT, ValueT>;
+
+    /**
+     * Location of a pair within the table: its slot (item is always 0)
+     */
+    struct Position
+    {
+        size_t bucket;
+
+        size_t item;
+
+        bool operator==(const Position & other) const
+        {
+            return bucket == other.bucket and item == other.item;
+        }
+    };
+
+    /**
+     * Constructs a table with the given number of slots
+     * @param capacity - number of slots, must be a power of two multiple of GROUP_WIDTH (see validCapacity)
+     * @param hash - hash function of the keys
+     * @param equal - equality of the keys
+     * @param allocator - allocator of the control bytes and of the slots array
+     * @param deferSlots - DEFER_SLOTS to allocate the control bytes without marking them empty
+     * (see initializeSlots)
+     */
+    explicit SwissTable(size_t capacity = 0, const Hash & hash = Hash(), const KeyEqual & equal = KeyEqual(),
+                        const Allocator & allocator = Allocator(), bool deferSlots = false) :
+            _capacity(capacity), _tombstones(0), _groups(nullptr), _slots(nullptr), _hash(hash), _equal(equal),
+            _slotAllocator(allocator), _groupAllocator(allocator)
+    {
+        if (_capacity != 0)
+        {
+            _groups = _groupAllocator.allocate(_capacity / GROUP_WIDTH);
+            _slots = _slotAllocator.allocate(_capacity);
+            if (!deferSlots)
+            {
+                initializeSlots(0, _capacity);
+            }
+        }
+    }
+
+    SwissTable(const SwissTable & other) = delete;
+
+    SwissTable & operator=(const SwissTable & other) = delete;
+
+    /**
+     * Destructor
+     */
+    ~SwissTable()
+    {
+        if (_capacity != 0)
+        {
+            clear();
+            _groupAllocator.deallocate(_groups, _capacity / GROUP_WIDTH);
+            _slotAllocator.deallocate(_slots, _capacity);
+        }
+    }
+
+    /**
+     * Marks the control bytes of the slots in the given range of a table constructed with DEFER_SLOTS empty;
+     * every slot must be marked once before the table is used
+     * @param first - first slot to mark
+     * @param last - one past the last slot to mark
+     */
+    void initializeSlots(size_t first, size_t last)
+    {
+        std::memset(reinterpret_cast<signed char *>(_groups) + first, CTRL_EMPTY, last - first);
+    }
+
+    /**
+     * Frees the control bytes and the slots without visiting them, leaving a table with no slots. Only for a
+     * table holding no pair: one emptied slot by slot by takeBucket, or one whose slots were never marked.
+     */
+    void releaseEmpty()
+    {
+        if (_capacity != 0)
+        {
+            _groupAllocator.deallocate(_groups, _capacity / GROUP_WIDTH);
+            _slotAllocator.deallocate(_slots, _capacity);
+            _groups = nullptr;
+            _slots = nullptr;
+        }
+        _capacity = 0;
+        _tombstones = 0;
+    }
+
+    /**
+     * @param requested - the capacity the map asked for
+     * @return the nearest capacity this table can be built with (a power of two, at least one group)
+     */
+    static size_t validCapacity(size_t requested)
+    {
+        size_t capacity = GROUP_WIDTH;
+        while (capacity < requested)
+        {
+            capacity <<= 1;
+        }
+        return capacity;
+    }
+
+    /**
+     * @return the number of slots
+     */
+    size_t capacity() const
+    {
+        return _capacity;
+    }
+
+    /**
+     * @return the hash function of the table
+     */
+    const Hash & hashFunction() const
+    {
+        return _hash;
+    }
+
+    /**
+     * @return the key equality of the table
+     */
+    const KeyEqual & keyEqual() const
+    {
+        return _equal;
+    }
+
+    /**
+     * @return the allocator of the table
+     */
+    Allocator allocator() const
+    {
+        return Allocator(_slotAllocator);
+    }
+
+    /**
+     * @return number of slots left DELETED by erase, they can not end a probe so the map counts them as used
+     */
+    size_t tombstones() const
+    {
+        return _tombstones;
+    }
+
+    /**
+     * @param key - key value, or a value of any type the (transparent) hash function accepts
+     * @return the (mixed, see mixHash) hash code of the key, computed once per operation and passed to the
+     * other methods
+     */
+    template<class K>
+    size_t hashOf(const K & key) const
+    {
+        return mixHash(_hash(key));
+    }
+
+    /**
+     * @param hash - hash code of a key
+     * @return the index of the group probing starts from
+     */
+    size_t bucketIndex(size_t hash) const
+    {
+        return _homeGroup(hash);
+    }
+
+    /**
+     * Starts loading the home group of the given hash code (its control bytes and its first slot) into the
+     * cache, for a find that follows
+     * @param hash - hash code of a key
+     */
+    void prefetch(size_t hash) const
+    {
+        size_t group = _homeGroup(hash);
+        prefetchAddress(&_groups[group]);
+        prefetchAddress(&_slots[group * GROUP_WIDTH]);
+    }
+
+    /**
+     * @param key - key value, or a value of any type the (transparent) hash function accepts
+     * @param hash - hash code of the key
+     * @return position of the pair holding the key, end() if the key is not in the table
+     */
+    template<class K>
+    Position find(const K & key, size_t hash) const
+    {
+        size_t group = _homeGroup(hash);
+        signed char fingerprint = _fingerprint(hash);
+
+        for (size_t step = 1; step <= _capacity / GROUP_WIDTH; step++)
+        {
+            for (unsigned int match = _matchByte(group, fingerprint); match != 0; match &= match - 1)
+            {
+                size_t index = group * GROUP_WIDTH + _lowestBit(match);
+                if (_slots[index].hashMatches(hash) and _equal(_pairAt(index)->first, key))
+                {
+                    return {index, 0};
+                }
+            }
+            if (_matchByte(group, CTRL_EMPTY) != 0)
+            {
+                break;
+            }
+            group = _nextGroup(group, step);
+        }
+        return end();
+    }
+
+    /**
+     * Adds a pair whose key is known not to be in the table, the table must have a free slot
+     * @param pair - (key,value) to add
+     * @param hash - hash code of the key
+     * @return position of the stored pair
+     */
+    Position insertNew(tuple && pair, size_t hash)
+    {
+        size_t group = _homeGroup(hash);
+
+        for (size_t step = 1;; step++)
+        {
+            unsigned int free = _matchFree(group);
+            if (free != 0)
+            {
+                size_t index = group * GROUP_WIDTH + _lowestBit(free);
+                if (_control(index) == CTRL_DELETED)
+                {
+                    _tombstones--;
+                }
+                _control(index) = _fingerprint(hash);
+                new(_slots[index].storage) tuple(std::move(pair));
+                _slots[index].storeHash(hash);
+                return {index, 0};
+            }
+            group = _nextGroup(group, step);
+        }
+    }
+
+    /**
+     * Moves every pair of the given table into this one (re-hashing), using the stored hash codes (if kept)
+     * instead of hashing the keys again; the pairs are moved and never compared, as they are known to be distinct.
+     * @param source - table to empty
+     */
+    void takeAll(SwissTable & source)
+    {
+        for (size_t i = 0; i < source._capacity; i++)
+        {
+            if (source._control(i) >= 0)
+            {
+                insertNew(std::move(*source._pairAt(i)), source._hashAt(i));
+                source._pairAt(i)->~tuple();
+                source._control(i) = CTRL_EMPTY;
+            }
+        }
+        source._tombstones = 0;
+    }
+
+    /**
+     * Moves the pair of one slot of the given table into this one (one step of an incremental re-hash)
+     * @param source - table to move the pair from
+     * @param index - the slot in the source table
+     * @return number of pairs moved
+     */
+    size_t takeBucket(SwissTable & source, size_t index)
+    {
+        if (source._control(index) < 0)
+        {
+            return 0;
+        }
+        takeFrom(source, {index, 0});
+        return 1;
+    }
+
+    /**
+     * Moves one pair of the given table into this one, erasing it from the source
+     * @param source - table to move the pair from
+     * @param position - position of the pair in the source table
+     * @return position of the pair in this table
+     */
+    Position takeFrom(SwissTable & source, const Position & position)
+    {
+        Position placed = insertNew(std::move(*source._pairAt(position.bucket)), source._hashAt(position.bucket));
+        source.erase(position);
+        return placed;
+    }
+
+    /**
+     * Copies every pair of the given table into this one, which must be empty and of the same capacity, slot by slot along with the control bytes:
+     * the layout is cloned as it is, so no key is hashed, compared or probed for
+     * @param source - table to copy
+     */
+    void cloneFrom(const SwissTable & source)
+    {
+        for (size_t i = 0; i < _capacity; i++)
+        {
+            // a slot is marked full only once its pair is built, so a throwing copy leaves a valid table
+            if (source._control(i) >= 0)
+            {
+                new(_slots[i].storage) tuple(*source._pairAt(i));
+                _slots[i].copyHash(source._slots[i]);
+            }
+            _control(i) = source._control(i);
+        }
+        _tombstones = source._tombstones;
+    }
+
+    /**
+     * Removes the pair in the given position (which must not be end())
+     */
+    void erase(const Position & position)
+    {
+        size_t index = position.bucket;
+        _pairAt(index)->~tuple();
+
+        // a group that still has an EMPTY slot never overflowed, so no probe ever went past it
+        if (_matchByte(index / GROUP_WIDTH, CTRL_EMPTY) != 0)
+        {
+            _control(index) = CTRL_EMPTY;
+        }
+        else
+        {
+            _control(index) = CTRL_DELETED;
+            _tombstones++;
+        }
+    }
+
+    /**
+     * Removes all the pairs, keeping the capacity
+     */
+    void clear()
+    {
+        for (size_t i = 0; i < _capacity; i++)
+        {
+            if (_control(i) >= 0)
+            {
+                _pairAt(i)->~tuple();
+            }
+        }
+        if (_capacity != 0)
+        {
+            std::memset(_groups, CTRL_EMPTY, _capacity);
+        }
+        _tombstones = 0;
+    }
+
+    /**
+     * @return bytes allocated by the table: the control bytes and the array of slots
+     */
+    size_t allocatedBytes() const
+    {
+        return _capacity / GROUP_WIDTH * sizeof(Group) + _capacity * sizeof(Slot);
+    }
+
+    /**
+     * Counts every pair in a probe length histogram (see HashMapStats): a pair is found at the probe of its
+     * group along the probe sequence from its home group
+     * @param histogram - the histogram to add to
+     */
+    void probeLengths(std::vector<size_t> & histogram) const
+    {
+        for (size_t i = 0; i < _capacity; i++)
+        {
+            if (_control(i) >= 0)
+            {
+                size_t group = _homeGroup(_hashAt(i));
+                size_t step = 1;
+                for (; group != i / GROUP_WIDTH; step++)
+                {
+                    group = _nextGroup(group, step);
+                }
+                countProbeLength(histogram, step);
+            }
+        }
+    }
+
+    /**
+     * @param hash - hash code of a key
+     * @return number of pairs stored in the home group of the key
+     */
+    size_t bucketSize(size_t hash) const
+    {
+        size_t group = bucketIndex(hash);
+        size_t count = 0;
+        for (size_t i = 0; i < GROUP_WIDTH; i++)
+        {
+            if (_control(group * GROUP_WIDTH + i) >= 0)
+            {
+                count++;
+            }
+        }
+        return count;
+    }
+
+    /**
+     * @return position of the first pair in the table or end() if the table is empty
+     */
+    Position begin() const
+    {
+        Position position = {0, 0};
+        _skipEmpty(position);
+        return position;
+    }
+
+    /**
+     * @return the position past the last pair, the same for every table and every capacity
+     */
+    Position end() const
+    {
+        return {END_BUCKET, 0};
+    }
+
+    /**
+     * Moves the given position to the next pair in the table (or to end())
+     */
+    void advance(Position & position) const
+    {
+        position.bucket++;
+        _skipEmpty(position);
+    }
+
+    /**
+     * @return the pair in the given position (which must not be end())
+     */
+    tuple & at(const Position & position) const
+    {
+        return *_pairAt(position.bucket);
+    }
+
+    /**
+     * @return the hash code of the key of the pair in the given position (which must not be end()), without
+     * hashing the key when the table keeps hash codes
+     */
+    size_t hashAt(const Position & position) const
+    {
+        return _hashAt(position.bucket);
+    }
+
+    /**
+     * This exchanges the contents of two tables
+     */
+    void swap(SwissTable & other) noexcept
+    {
+        std::swap(_capacity, other._capacity);
+        std::swap(_tombstones, other._tombstones);
+        std::swap(_groups, other._groups);
+        std::swap(_slots, other._slots);
+        std::swap(_hash, other._hash);
+        std::swap(_equal, other._equal);
+        std::swap(_slotAllocator, other._slotAllocator);
+        std::swap(_groupAllocator, other._groupAllocator);
+    }
+
+private:
+
+    /**
+     * The control bytes of one group of slots
+     */
+    struct alignas(GROUP_WIDTH) Group
+    {
+        signed char control[GROUP_WIDTH];
+    };
+
+    /**
+     * The hash code of the key of a pair (if kept) and raw storage for the pair itself
+     */
+    struct Slot : StoredHash<CacheHash>
+    {
+        alignas(tuple) unsigned char storage[sizeof(tuple)];
+    };
+
+    size_t _capacity;
+
+    size_t _tombstones;
+
+    Group *_groups;
+
+    Slot *_slots;
+
+    Hash _hash;
+
+    KeyEqual _equal;
+
+    typename std::allocator_traits<Allocator>::template rebind_alloc<Slot> _slotAllocator;
+
+    typename std::allocator_traits<Allocator>::template rebind_alloc<Group> _groupAllocator;
+
+    /**
+     * @return the control byte of the given slot
+     */
+    signed char & _control(size_t index) const
+    {
+        return _groups[index / GROUP_WIDTH].control[index % GROUP_WIDTH];
+    }
+
+    /**
+     * @return the pair stored in the given (full) slot
+     */
+    tuple *_pairAt(size_t index) const
+    {
+        return std::launder(reinterpret_cast<tuple *>(_slots[index].storage));
+    }
+
+    /**
+     * @return the hash code of the key of the pair in the given (occupied) slot
+     */
+    size_t _hashAt(size_t index) const
+    {
+        return _slots[index].storedHash(_hash, _pairAt(index)->first);
+    }
+
+    /**
+     * @return the fingerprint of a hash code, the value of the control byte of a full slot
+     */
+    static signed char _fingerprint(size_t hash)
+    {
+        return static_cast<signed char>(hash & FINGERPRINT_MASK);
+    }
+
+    /**
+     * @return the group probing of the given hash code starts from
+     */
+    size_t _homeGroup(size_t hash) const
+    {
+        return (hash >> FINGERPRINT_BITS) & (_capacity / GROUP_WIDTH - 1);
+    }
+
+    /**
+     * Triangular probing over the groups, visits every group once since their number is a power of two
+     * @return the group to probe after the given one
+     */
+    size_t _nextGroup(size_t group, size_t step) const
+    {
+        return (group + step) & (_capacity / GROUP_WIDTH - 1);
+    }
+
+    /**
+     * @return index of the lowest set bit of a non zero mask
+     */
+    static unsigned int _lowestBit(unsigned int mask)
+    {
+        return static_cast<unsigned int>(__builtin_ctz(mask));
+    }
+
+    /**
+     * @return bit mask of the slots in the given group whose control byte equals the given one
+     */
+    unsigned int _matchByte(size_t group, signed char control) const
+    {
+#ifdef __SSE2__
+        __m128i bytes = _mm_load_si128(reinterpret_cast<const __m128i *>(_groups[group].control));
+        return static_cast<unsigned int>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(control))));
+#else
+        unsigned int mask = 0;
+        for (size_t i = 0; i < GROUP_WIDTH; i++)
+        {
+            if (_groups[group].control[i] == control)
+            {
+                mask |= 1u << i;
+            }
+        }
+        return mask;
+#endif
+    }
+
+    /**
+     * @return bit mask of the slots in the given group that are EMPTY or DELETED (negative control byte)
+     */
+    unsigned int _matchFree(size_t group) const
+    {
+#ifdef __SSE2__
+        __m128i bytes = _mm_load_si128(reinterpret_cast<const __m128i *>(_groups[group].control));
+        return static_cast<unsigned int>(_mm_movemask_epi8(bytes));
+#else
+        unsigned int mask = 0;
+        for (size_t i = 0; i < GROUP_WIDTH; i++)
+        {
+            if (_groups[group].control[i] < 0)
+            {
+                mask |= 1u << i;
+            }
+        }
+        return mask;
+#endif
+    }
+
+    /**
+     * Moves the given position forward until it points to a pair or to end()
+     */
+    void _skipEmpty(Position & position) const
+    {
+        while (position.bucket < _capacity and _control(position.bucket) < 0)
+        {
+            position.bucket++;
+        }
+        if (position.bucket == _capacity)
+        {
+            position = end();
+        }
+    }
+};
+
+/**
+ * Storage policy of HashMap: open addressing with SIMD group probing over fingerprint control bytes
+ */
+struct SwissStorage
+{
+    template<class KeyT, class ValueT, class Hash, class KeyEqual, class Allocator>
+    using table = SwissTable<KeyT, ValueT, Hash, KeyEqual, Allocator, CacheHashCode<KeyT>::value>;
+};
+
+#endif